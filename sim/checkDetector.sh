@@ -0,0 +1,34 @@
+#!/bin/sh
+# Checks the lightning detector over sim/detectorTrace.csv: which channel sees
+# each event first, that the photodiode baseline holds through a flash, and that
+# it lets go of a light that stays on after a second and takes it as ambient.
+#
+#   pio run -e simulator && sim/checkDetector.sh [program]
+
+PROGRAM=${1:-.pio/build/simulator/program}
+TRACE=$(dirname "$0")/detectorTrace.csv
+
+"$PROGRAM" --trace "$TRACE" --photodiode --ldr-threshold 30 --pd-threshold 200 | awk '
+    function check(ok, what) {
+        print (ok ? "pass: " : "FAIL: ") what
+        if (!ok)
+            failed = 1
+    }
+    # Detection <start> s for <ms> ms, first seen by <channel>, photodiode baseline <from> to <to>
+    /^Detection/ {
+        n++
+        sub(/,$/, "", $10)
+        ms[n] = $5; channel[n] = $10; from[n] = $13; to[n] = $15
+    }
+    END {
+        check(n == 4, "4 detections, got " n)
+        check(channel[1] == "photodiode", "flash seen by the photodiode first")
+        check(from[1] == to[1], "baseline held through the flash")
+        check(channel[2] == "ldr", "glow below the photodiode threshold seen by the LDR")
+        check(channel[3] == "photodiode" && ms[3] > 950 && ms[3] < 1050,
+              "light left on let go after a second, " ms[3] " ms")
+        check(to[3] == 1000, "baseline taken from the light left on, " to[3])
+        check(channel[4] == "photodiode" && from[4] == 1000 && to[4] == 1000,
+              "flash over the new ambient seen, baseline held")
+        exit failed
+    }'
@@ -0,0 +1,41 @@
+#!/bin/sh
+# Checks what the timelapse costs lightning. Runs the same storms without and
+# with it, and fails if a flash near a timelapse photo was caught more than
+# BOUND_MS later, or lost although it stayed lit that long. The bound is the
+# simulated camera's 200 ms write-out of the timelapse photo, plus the four
+# 15 ms BLE writes of a lightning shot cutting in on it. Flashes over before
+# then are lost however it's done, but more than MAX_LOST in a storm, about a
+# tenth of those near a timelapse photo, fails too.
+#
+#   pio run -e simulator && sim/checkTimelapse.sh [program]
+
+PROGRAM=${1:-.pio/build/simulator/program}
+BOUND_MS=260
+MAX_LOST=3
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+printf 'tap 3 70 265\n' >"$work/still.txt"                   # Running
+printf 'tap 3 70 265\ntap 4 70 195\n' >"$work/timelapse.txt" # Running, then Still+TL
+
+status=0
+for seed in 1 2 3; do
+    storm="--quiet --duration 3600 --flash-rate 20 --seed $seed"
+    "$PROGRAM" $storm --script "$work/still.txt" --save-latencies "$work/base.txt" >/dev/null ||
+        exit 1
+    if "$PROGRAM" $storm --script "$work/timelapse.txt" --baseline "$work/base.txt" \
+        --max-extra-latency $BOUND_MS --max-lost $MAX_LOST >"$work/report.txt"; then
+        result=pass
+    else
+        result=FAIL
+        status=1
+    fi
+    # Baseline:  <n> flashes within 1 s of a timelapse shot: worst <ms> ms, mean <ms> ms, <n> lost
+    awk -v seed=$seed -v result=$result '/^Baseline:/ {
+        printf "Seed %s: %s, worst %s ms, %d of %d lost\n", seed, result, $12, $17, $2 + $17
+        found = 1
+    }
+    END { if (!found) printf "Seed %s: %s\n", seed, result }' "$work/report.txt"
+    grep -A1 '^Baseline:' "$work/report.txt"
+done
+exit $status
@@ -0,0 +1,206 @@
+// Simulator implementation of the hardware abstraction layer (see hal.h).
+
+#include "hal.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "simClock.h"
+#include "simHal.h"
+#include "simLight.h"
+#include "simOptions.h"
+
+namespace
+{
+const uint64_t ADC_READ_US     = 9;      // One raw ADC1 conversion
+const uint64_t DISPLAY_INIT_US = 150000; // Reset and sleep-out delays in the ST7789 init
+const uint64_t TOUCH_READ_US   = 60;     // XPT2046 transfer, shares the display SPI bus
+const uint64_t TASK_YIELD_US   = 1000;   // vTaskDelay(1)
+const uint64_t BACKGROUND_US   = 10000;  // The background task's sleep between passes
+const uint64_t NVS_READ_US     = 1000;
+const uint64_t NVS_WRITE_US    = 15000;  // Includes the occasional page erase
+const uint64_t FLASH_ERASE_US  = 45000;  // Typical 4K sector erase
+const uint64_t FLASH_WRITE_US  = 100;    // Per write, plus...
+const uint64_t FLASH_BYTE_US   = 3;      // ...page programming at about 0.7ms per 256 bytes
+const size_t   LOG_FLASH_SIZE  = 32 * hal::LOG_FLASH_SECTOR;
+
+struct Tap
+{
+    uint64_t start, duration;
+    int      x, y;
+};
+
+SimDisplay       cyd(RES_X, RES_Y);
+std::vector<Tap> taps;
+int              backlight = 0;
+sim::SensorStats stats;
+uint64_t         lastSample = 0;
+
+std::vector<uint8_t> logFlash;
+sim::FlashStats      flashStats;
+
+// The flash starts out erased, or as the --flash file left it
+std::vector<uint8_t>& flash()
+{
+    if (logFlash.empty())
+    {
+        logFlash.assign(LOG_FLASH_SIZE, 0xFF);
+        if (FILE* file = fopen(sim::options().flash.c_str(), "rb"))
+        {
+            size_t read = fread(logFlash.data(), 1, logFlash.size(), file);
+            (void)read; // A short file leaves the rest erased
+            fclose(file);
+        }
+    }
+    return logFlash;
+}
+
+void saveFlash()
+{
+    if (sim::options().flash.empty())
+        return;
+    if (FILE* file = fopen(sim::options().flash.c_str(), "wb"))
+    {
+        fwrite(logFlash.data(), 1, logFlash.size(), file);
+        fclose(file);
+    }
+}
+
+void flashOperation(uint64_t us)
+{
+    // Both cores stall: sensing included, nothing runs until it's over
+    sim::stallAll(us);
+    flashStats.longestOperation = std::max(flashStats.longestOperation, us);
+}
+} // namespace
+
+// ================================================
+// Simulator side
+
+void sim::addTap(uint64_t at, uint64_t duration, int x, int y)
+{
+    taps.push_back({at, duration, x, y});
+}
+
+SimDisplay& sim::screen() { return cyd; }
+
+int sim::backlightLevel() { return backlight; }
+
+const sim::SensorStats& sim::sensorStats() { return stats; }
+
+const sim::FlashStats& sim::flashStats() { return ::flashStats; }
+
+// ================================================
+// HAL
+
+void hal::init() {}
+
+void hal::initDisplay()
+{
+    sim::advance(DISPLAY_INIT_US);
+    cyd.fillRect(0, 0, RES_X, RES_Y, 0);
+}
+
+void hal::initTouch() {}
+
+Display& hal::display() { return cyd; }
+
+bool hal::hasPhotodiode() { return sim::options().photodiode; }
+
+void hal::readLightSensors(LightSample& sample)
+{
+    sim::advance(ADC_READ_US);
+    sample.ldr        = sim::readLdr();
+    sample.photodiode = 0;
+    if (hasPhotodiode())
+    {
+        sim::advance(ADC_READ_US);
+        sample.photodiode = sim::readPhotodiode();
+    }
+
+    uint64_t now = sim::now();
+    if (stats.samples == 0)
+        stats.firstSample = now;
+    else if (now - lastSample > stats.maxGap)
+    {
+        stats.maxGap   = now - lastSample;
+        stats.maxGapAt = now;
+    }
+    lastSample = now;
+    stats.samples++;
+}
+
+bool hal::readTouch(int& x, int& y)
+{
+    sim::advance(TOUCH_READ_US);
+    uint64_t now = sim::now();
+    for (const Tap& tap : taps)
+    {
+        if (now >= tap.start && now < tap.start + tap.duration)
+        {
+            x = tap.x;
+            y = tap.y;
+            return true;
+        }
+    }
+    return false;
+}
+
+void hal::setBacklight(uint8_t level) { backlight = level; }
+
+void hal::startSensingTask(void (*pass)()) { sim::startTask(pass, TASK_YIELD_US); }
+
+void hal::startBackgroundTask(void (*pass)()) { sim::startTask(pass, BACKGROUND_US); }
+
+bool hal::loadSettings(void* data, size_t size)
+{
+    sim::advance(NVS_READ_US);
+    if (sim::options().nvs.empty())
+        return false;
+    FILE* file = fopen(sim::options().nvs.c_str(), "rb");
+    if (!file)
+        return false;
+    bool found = fread(data, 1, size, file) == size && fgetc(file) == EOF;
+    fclose(file);
+    return found;
+}
+
+void hal::saveSettings(const void* data, size_t size)
+{
+    sim::stallAll(NVS_WRITE_US); // NVS is flash too, so sensing stalls with it
+    if (sim::options().nvs.empty())
+        return;
+    FILE* file = fopen(sim::options().nvs.c_str(), "wb");
+    if (!file)
+        return;
+    fwrite(data, 1, size, file);
+    fclose(file);
+}
+
+size_t hal::logFlashSize() { return flash().size(); }
+
+void hal::readLogFlash(size_t offset, void* data, size_t size)
+{
+    sim::advance(FLASH_WRITE_US / 10 + size / 40); // Reads run at cache refill speed
+    memcpy(data, flash().data() + offset, size);
+}
+
+void hal::writeLogFlash(size_t offset, const void* data, size_t size)
+{
+    flashOperation(FLASH_WRITE_US + size * FLASH_BYTE_US);
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++)
+        flash()[offset + i] &= bytes[i]; // Programming only clears bits
+    flashStats.bytesWritten += size;
+    saveFlash();
+}
+
+void hal::eraseLogFlashSector(size_t offset)
+{
+    flashOperation(FLASH_ERASE_US);
+    std::fill_n(flash().begin() + offset, LOG_FLASH_SECTOR, 0xFF);
+    flashStats.erases++;
+    saveFlash();
+}
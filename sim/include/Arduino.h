@@ -0,0 +1,66 @@
+#pragma once
+// Host stand-in for the parts of the Arduino core the firmware uses.
+//
+// Time comes from the simulator's virtual clock and Serial is modelled as a
+// 115200 baud UART with a 128 byte FIFO, so prints cost what they cost on the
+// board. Everything else is plain C++.
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+typedef uint8_t byte;
+
+unsigned long millis();
+unsigned long micros();
+void          delay(unsigned long ms);
+long          map(long x, long in_min, long in_max, long out_min, long out_max);
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+using std::abs;
+
+// Like the Arduino String, this always keeps its text on the heap.
+class String
+{
+  public:
+    String(const char* text = "");
+    String(int value);
+    String(unsigned int value);
+    String(long value);
+    String(unsigned long value);
+    String(const String& other);
+    ~String();
+    String&     operator=(const String& other);
+    const char* c_str() const { return _buffer; }
+    size_t      length() const;
+
+  private:
+    char* _buffer;
+};
+
+class HardwareSerial
+{
+  public:
+    void   begin(unsigned long baud);
+    size_t write(const char* data, size_t length);
+    size_t print(const char* text);
+    size_t print(const String& text) { return print(text.c_str()); }
+    size_t print(char c) { return write(&c, 1); }
+    size_t print(int value) { return print(long(value)); }
+    size_t print(unsigned int value) { return print((unsigned long)value); }
+    size_t print(long value);
+    size_t print(unsigned long value);
+    size_t print(double value, int digits = 2);
+    size_t println() { return print("\r\n"); }
+    template <typename T> size_t println(T value)
+    {
+        size_t n = print(value);
+        return n + println();
+    }
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    int    availableForWrite(); // Free space in the FIFO
+    void   flush();
+};
+
+extern HardwareSerial Serial;
@@ -0,0 +1,184 @@
+#pragma once
+// Host stand-in for the ESP32 Arduino BLE library.
+//
+// Only the classes and calls SonyBluetoothRemote uses are provided. Behind them
+// sits a single simulated camera (see simCamera.h) that advertises, accepts a
+// connection and records the remote control commands written to it. Blocking
+// calls advance the virtual clock by typical on-air times.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+typedef uint8_t esp_bd_addr_t[6];
+
+enum esp_ble_sec_act_t
+{
+    ESP_BLE_SEC_ENCRYPT = 1,
+    ESP_BLE_SEC_ENCRYPT_NO_MITM,
+    ESP_BLE_SEC_ENCRYPT_MITM,
+};
+
+struct esp_ble_auth_cmpl_t
+{
+    esp_bd_addr_t bd_addr;
+    bool          success;
+};
+
+class BLEClient;
+class BLEScan;
+
+class BLEAddress
+{
+  public:
+    BLEAddress(esp_bd_addr_t address);
+    esp_bd_addr_t* getNative() { return &_address; }
+    std::string    toString() const;
+
+  private:
+    esp_bd_addr_t _address;
+};
+
+class BLEUUID
+{
+  public:
+    BLEUUID(uint16_t uuid) : _uuid(uuid) {}
+    uint16_t value() const { return _uuid; }
+
+  private:
+    uint16_t _uuid;
+};
+
+class BLEAdvertisedDevice
+{
+  public:
+    std::string getName() { return _name; }
+    BLEAddress  getAddress() { return BLEAddress(_address); }
+    BLEScan*    getScan() { return _scan; }
+    uint8_t*    getPayload() { return _payload; }
+    size_t      getPayloadLength() { return _payloadLength; }
+
+  private:
+    friend class BLEScan;
+    std::string   _name;
+    esp_bd_addr_t _address       = {};
+    BLEScan*      _scan          = nullptr;
+    uint8_t       _payload[31]   = {};
+    size_t        _payloadLength = 0;
+};
+
+class BLEAdvertisedDeviceCallbacks
+{
+  public:
+    virtual ~BLEAdvertisedDeviceCallbacks() = default;
+    virtual void onResult(BLEAdvertisedDevice advertisedDevice) = 0;
+};
+
+class BLEClientCallbacks
+{
+  public:
+    virtual ~BLEClientCallbacks() = default;
+    virtual void onConnect(BLEClient* pclient)    = 0;
+    virtual void onDisconnect(BLEClient* pclient) = 0;
+};
+
+class BLESecurityCallbacks
+{
+  public:
+    virtual ~BLESecurityCallbacks() = default;
+    virtual uint32_t onPassKeyRequest()                            = 0;
+    virtual void     onPassKeyNotify(uint32_t pass_key)            = 0;
+    virtual bool     onSecurityRequest()                           = 0;
+    virtual void     onAuthenticationComplete(esp_ble_auth_cmpl_t) = 0;
+    virtual bool     onConfirmPIN(uint32_t pin)                    = 0;
+};
+
+class BLEScanResults
+{
+  public:
+    int getCount() { return _count; }
+
+  private:
+    friend class BLEScan;
+    int _count = 0;
+};
+
+class BLEScan
+{
+  public:
+    void setAdvertisedDeviceCallbacks(BLEAdvertisedDeviceCallbacks* pCallbacks,
+                                      bool wantDuplicates = false, bool shouldParse = true)
+    {
+        _callbacks = pCallbacks;
+    }
+    void           setActiveScan(bool active) {}
+    BLEScanResults start(uint32_t duration, bool is_continue = false);
+    void           stop() { _stopped = true; }
+
+  private:
+    BLEAdvertisedDeviceCallbacks* _callbacks = nullptr;
+    bool                          _stopped   = false;
+};
+
+class BLERemoteCharacteristic;
+typedef void (*notify_callback)(BLERemoteCharacteristic* pBLERemoteCharacteristic, uint8_t* pData,
+                                size_t length, bool isNotify);
+
+class BLERemoteCharacteristic
+{
+  public:
+    void writeValue(uint8_t* data, size_t length, bool response = false);
+    void registerForNotify(notify_callback callback, bool notifications = true,
+                           bool descriptorRequiresRegistration = true)
+    {
+        _notifyCallback = callback;
+    }
+
+  private:
+    friend class BLEClient;
+    BLEClient*      _client         = nullptr;
+    notify_callback _notifyCallback = nullptr;
+};
+
+class BLERemoteService
+{
+  public:
+    BLERemoteCharacteristic* getCharacteristic(BLEUUID uuid);
+
+  private:
+    friend class BLEClient;
+    BLERemoteCharacteristic _command;
+    BLERemoteCharacteristic _notify;
+};
+
+class BLEClient
+{
+  public:
+    void              setClientCallbacks(BLEClientCallbacks* pClientCallbacks)
+    {
+        _callbacks = pClientCallbacks;
+    }
+    bool              connect(BLEAddress address);
+    bool              isConnected() { return _connected; }
+    BLERemoteService* getService(const char* uuid);
+
+    // Simulator side
+    void simDisconnect();
+    void simNotify(const uint8_t* data, size_t length); // From the camera, on FF02
+
+  private:
+    friend class BLERemoteCharacteristic;
+    BLEClientCallbacks* _callbacks = nullptr;
+    bool                _connected = false;
+    BLERemoteService    _service;
+};
+
+class BLEDevice
+{
+  public:
+    static void       init(std::string deviceName);
+    static void       setEncryptionLevel(esp_ble_sec_act_t level) {}
+    static void       setSecurityCallbacks(BLESecurityCallbacks* pCallbacks);
+    static BLEClient* createClient();
+    static BLEScan*   getScan();
+};
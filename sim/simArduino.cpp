@@ -0,0 +1,143 @@
+#include <Arduino.h>
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#include "simClock.h"
+#include "simOptions.h"
+
+// ================================================
+// Time
+
+unsigned long millis() { return (unsigned long)(sim::now() / 1000); }
+
+unsigned long micros() { return (unsigned long)sim::now(); }
+
+void delay(unsigned long ms) { sim::advance(uint64_t(ms) * 1000); }
+
+long map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+// ================================================
+// String
+
+namespace
+{
+char* duplicate(const char* text)
+{
+    size_t length = strlen(text);
+    char*  buffer = (char*)malloc(length + 1);
+    memcpy(buffer, text, length + 1);
+    return buffer;
+}
+
+char* format(const char* format, ...)
+{
+    char    text[32];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    return duplicate(text);
+}
+} // namespace
+
+String::String(const char* text) : _buffer(duplicate(text)) {}
+String::String(int value) : _buffer(format("%d", value)) {}
+String::String(unsigned int value) : _buffer(format("%u", value)) {}
+String::String(long value) : _buffer(format("%ld", value)) {}
+String::String(unsigned long value) : _buffer(format("%lu", value)) {}
+String::String(const String& other) : _buffer(duplicate(other._buffer)) {}
+String::~String() { free(_buffer); }
+
+String& String::operator=(const String& other)
+{
+    if (this != &other)
+    {
+        free(_buffer);
+        _buffer = duplicate(other._buffer);
+    }
+    return *this;
+}
+
+size_t String::length() const { return strlen(_buffer); }
+
+// ================================================
+// Serial
+
+HardwareSerial Serial;
+
+namespace
+{
+const uint64_t UART_US_PER_BYTE = 87; // 10 bits at 115200 baud
+const uint64_t UART_FIFO_SIZE   = 128;
+
+uint64_t uartIdleAt  = 0;    // When the FIFO will have drained
+bool     atLineStart = true; // For timestamping echoed lines
+} // namespace
+
+void HardwareSerial::begin(unsigned long baud) {}
+
+size_t HardwareSerial::write(const char* data, size_t length)
+{
+    // Writing blocks once the FIFO is full, until enough of it has drained.
+    uint64_t now = sim::now();
+    if (uartIdleAt < now)
+        uartIdleAt = now;
+    uint64_t queued = (uartIdleAt - now + UART_US_PER_BYTE - 1) / UART_US_PER_BYTE;
+    if (queued + length > UART_FIFO_SIZE)
+        sim::advance((queued + length - UART_FIFO_SIZE) * UART_US_PER_BYTE);
+    uartIdleAt += length * UART_US_PER_BYTE;
+
+    if (!sim::options().echoSerial)
+        return length;
+    for (size_t i = 0; i < length; i++)
+    {
+        if (data[i] == '\r')
+            continue;
+        if (atLineStart)
+            ::printf("[%10.3f] ", sim::now() / 1e6);
+        ::putchar(data[i]);
+        atLineStart = data[i] == '\n';
+    }
+    return length;
+}
+
+int HardwareSerial::availableForWrite()
+{
+    uint64_t now = sim::now();
+    if (uartIdleAt <= now)
+        return int(UART_FIFO_SIZE);
+    uint64_t queued = (uartIdleAt - now + UART_US_PER_BYTE - 1) / UART_US_PER_BYTE;
+    return int(UART_FIFO_SIZE - queued);
+}
+
+void HardwareSerial::flush()
+{
+    if (uartIdleAt > sim::now())
+        sim::advance(uartIdleAt - sim::now());
+    fflush(stdout);
+}
+
+size_t HardwareSerial::print(const char* text) { return write(text, strlen(text)); }
+
+size_t HardwareSerial::print(long value) { return printf("%ld", value); }
+
+size_t HardwareSerial::print(unsigned long value) { return printf("%lu", value); }
+
+size_t HardwareSerial::print(double value, int digits) { return printf("%.*f", digits, value); }
+
+size_t HardwareSerial::printf(const char* format, ...)
+{
+    char    text[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if (length < 0)
+        return 0;
+    return write(text, strlen(text));
+}
@@ -0,0 +1,277 @@
+// Fake BLE link and the simulated camera behind it.
+
+#include <BLEDevice.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <set>
+#include <memory>
+#include <vector>
+
+#include "simCamera.h"
+#include "simClock.h"
+#include "simOptions.h"
+
+namespace
+{
+// Typical on-air timings
+const uint64_t BLE_INIT_US       = 500000; // Controller and host stack bring-up
+const uint64_t DISCOVERY_US      = 200000; // Until the camera's advertisement is seen
+const uint64_t CONNECT_US        = 900000; // Connection, service discovery and encryption
+const uint64_t WRITE_RESPONSE_US = 15000;  // Two connection intervals
+const uint64_t WRITE_US          = 1000;
+const uint64_t RECORD_START_US   = 300000; // From the record button to the first frame
+const uint64_t SHOT_BUSY_US      = 200000; // Writing out a photo; a press meanwhile waits
+
+const uint8_t CAMERA_ADDRESS[6] = {0xD0, 0x40, 0xEF, 0x12, 0x34, 0x56};
+
+std::map<uint64_t, bool>                cameraPower;
+std::vector<uint64_t>                   shots;
+uint64_t                                shotReady   = 0;     // When the camera can take another photo
+bool                                    shutterDown = false; // Fully pressed, not yet let go
+std::vector<sim::Clip>                  clips;
+std::set<uint64_t>                      cameraStops;                 // Clips the camera ends itself
+uint64_t                                recordReportAt = UINT64_MAX; // Next recording notification
+bool                                    recordReportOn = false;
+int                                     connections = 0;
+bool                                    paired      = false;
+BLEScan                                 scan;
+std::vector<std::unique_ptr<BLEClient>> clients;
+BLESecurityCallbacks*                   securityCallbacks = nullptr;
+} // namespace
+
+// ================================================
+// Camera
+
+void sim::setCameraPower(uint64_t at, bool on) { cameraPower[at] = on; }
+
+bool sim::cameraIsOn(uint64_t at)
+{
+    auto next = cameraPower.upper_bound(at);
+    if (next == cameraPower.begin())
+        return true;
+    return std::prev(next)->second;
+}
+
+uint64_t sim::cameraNextOn(uint64_t from)
+{
+    if (cameraIsOn(from))
+        return from;
+    for (auto it = cameraPower.upper_bound(from); it != cameraPower.end(); ++it)
+    {
+        if (it->second)
+            return it->first;
+    }
+    return UINT64_MAX;
+}
+
+namespace
+{
+bool recording() { return !clips.empty() && clips.back().end == UINT64_MAX; }
+
+void stopRecording()
+{
+    if (recording())
+        clips.back().end = sim::now();
+}
+
+void reportRecording(uint64_t at, bool on)
+{
+    recordReportAt = at;
+    recordReportOn = on;
+}
+} // namespace
+
+void sim::cameraReceive(const uint8_t* data, size_t length)
+{
+    if (length != 2 || data[0] != 0x01)
+        return;
+    if (data[1] == 0x09) // Shutter fully pressed, only a photo if it had been let go
+    {
+        if (shutterDown)
+            return;
+        shutterDown = true;
+        uint64_t at = std::max(now(), shotReady);
+        shots.push_back(at);
+        shotReady = at + SHOT_BUSY_US;
+    }
+    else if (data[1] == 0x08) // Full press let go
+        shutterDown = false;
+    else if (data[1] == 0x0F) // Record button, toggles
+    {
+        if (recording())
+        {
+            stopRecording();
+            reportRecording(now(), false);
+        }
+        else
+        {
+            clips.push_back({now() + RECORD_START_US, UINT64_MAX});
+            reportRecording(clips.back().start, true);
+        }
+    }
+}
+
+const std::vector<uint64_t>&  sim::cameraShots() { return shots; }
+const std::vector<sim::Clip>& sim::cameraClips() { return clips; }
+
+int sim::cameraConnections() { return connections; }
+
+void sim::stopCameraRecording(uint64_t at) { cameraStops.insert(at); }
+
+void sim::bleUpdate()
+{
+    if (!cameraIsOn(now()))
+    {
+        stopRecording();
+        recordReportAt = UINT64_MAX;
+        for (auto& client : clients)
+            client->simDisconnect();
+        return;
+    }
+
+    if (!cameraStops.empty() && *cameraStops.begin() <= now())
+    {
+        cameraStops.erase(cameraStops.begin());
+        if (recording())
+        {
+            stopRecording();
+            reportRecording(now(), false);
+        }
+    }
+
+    if (recordReportAt <= now())
+    {
+        recordReportAt       = UINT64_MAX;
+        const uint8_t data[] = {0x02, 0xD5, uint8_t(recordReportOn ? 0x20 : 0x00)};
+        for (auto& client : clients)
+            client->simNotify(data, sizeof(data));
+    }
+}
+
+// ================================================
+// BLE library
+
+BLEAddress::BLEAddress(esp_bd_addr_t address) { memcpy(_address, address, sizeof(_address)); }
+
+std::string BLEAddress::toString() const
+{
+    char text[18];
+    snprintf(text, sizeof(text), "%02x:%02x:%02x:%02x:%02x:%02x", _address[0], _address[1],
+             _address[2], _address[3], _address[4], _address[5]);
+    return text;
+}
+
+BLEScanResults BLEScan::start(uint32_t duration, bool is_continue)
+{
+    BLEScanResults results;
+    uint64_t       end = sim::now() + uint64_t(duration) * 1000000;
+    _stopped           = false;
+
+    uint64_t seen = sim::cameraNextOn(sim::now());
+    if (seen != UINT64_MAX && seen + DISCOVERY_US < end)
+    {
+        sim::advance(seen + DISCOVERY_US - sim::now());
+
+        BLEAdvertisedDevice device;
+        device._name = sim::options().cameraName;
+        memcpy(device._address, CAMERA_ADDRESS, sizeof(CAMERA_ADDRESS));
+        device._scan = this;
+        // Sony manufacturer data; 0x22 is followed by the pairing state flags
+        const uint8_t payload[] = {0x02, 0x01, 0x06, 0x05, 0xFF, 0x2D, 0x01, 0x22,
+                                   uint8_t(paired ? 0x00 : 0x42)};
+        memcpy(device._payload, payload, sizeof(payload));
+        device._payloadLength = sizeof(payload);
+        results._count        = 1;
+        if (_callbacks)
+            _callbacks->onResult(device);
+    }
+
+    // Like the real thing, the scan runs its full duration unless stopped
+    if (!_stopped && sim::now() < end)
+        sim::advance(end - sim::now());
+    return results;
+}
+
+void BLERemoteCharacteristic::writeValue(uint8_t* data, size_t length, bool response)
+{
+    sim::advance(response ? WRITE_RESPONSE_US : WRITE_US);
+    if (_client && _client->isConnected())
+        sim::cameraReceive(data, length);
+}
+
+BLERemoteCharacteristic* BLERemoteService::getCharacteristic(BLEUUID uuid)
+{
+    switch (uuid.value())
+    {
+    case 0xFF01:
+        return &_command;
+    case 0xFF02:
+        return &_notify;
+    default:
+        return nullptr;
+    }
+}
+
+bool BLEClient::connect(BLEAddress address)
+{
+    sim::advance(CONNECT_US);
+    if (!sim::cameraIsOn(sim::now()) ||
+        memcmp(*address.getNative(), CAMERA_ADDRESS, sizeof(CAMERA_ADDRESS)) != 0)
+        return false;
+
+    _connected                = true;
+    _service._command._client = this;
+    _service._notify._client  = this;
+    connections++;
+    if (!paired && securityCallbacks)
+    {
+        esp_ble_auth_cmpl_t cmpl = {};
+        cmpl.success             = true;
+        securityCallbacks->onAuthenticationComplete(cmpl);
+    }
+    paired = true;
+    if (_callbacks)
+        _callbacks->onConnect(this);
+    return true;
+}
+
+BLERemoteService* BLEClient::getService(const char* uuid)
+{
+    return _connected ? &_service : nullptr;
+}
+
+void BLEClient::simDisconnect()
+{
+    if (!_connected)
+        return;
+    _connected  = false;
+    shutterDown = false;
+    stopRecording();
+    if (_callbacks)
+        _callbacks->onDisconnect(this);
+}
+
+void BLEClient::simNotify(const uint8_t* data, size_t length)
+{
+    BLERemoteCharacteristic& notify = _service._notify;
+    if (_connected && notify._notifyCallback)
+        notify._notifyCallback(&notify, const_cast<uint8_t*>(data), length, true);
+}
+
+void BLEDevice::init(std::string deviceName) { sim::advance(BLE_INIT_US); }
+
+void BLEDevice::setSecurityCallbacks(BLESecurityCallbacks* pCallbacks)
+{
+    securityCallbacks = pCallbacks;
+}
+
+BLEClient* BLEDevice::createClient()
+{
+    clients.emplace_back(new BLEClient);
+    return clients.back().get();
+}
+
+BLEScan* BLEDevice::getScan() { return &scan; }
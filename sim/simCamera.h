@@ -0,0 +1,33 @@
+#pragma once
+// The simulated Sony camera on the other end of the fake BLE link.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sim
+{
+void setCameraPower(uint64_t at, bool on); // Scheduled; the camera starts switched on
+bool cameraIsOn(uint64_t at);
+uint64_t cameraNextOn(uint64_t from); // UINT64_MAX if it never comes back
+void stopCameraRecording(uint64_t at); // Scheduled; the camera ends a clip itself, e.g. card full
+
+// Called by the fake BLE link for every remote command written to the camera.
+void cameraReceive(const uint8_t* data, size_t length);
+
+struct Clip
+{
+    uint64_t start, end; // end is UINT64_MAX while still recording
+};
+
+// Virtual time of every photo. Only a full press after the last one was let go
+// takes a photo, and one while the camera is still writing out the last photo
+// is taken once it's done.
+const std::vector<uint64_t>& cameraShots();
+const std::vector<Clip>&     cameraClips(); // Movie recordings
+int                          cameraConnections();
+
+// Runs between loop() calls, delivering disconnects when the camera powers off
+// and the camera's recording reports.
+void bleUpdate();
+} // namespace sim
@@ -0,0 +1,75 @@
+#include "simClock.h"
+
+#include <algorithm>
+
+namespace
+{
+struct Task
+{
+    void (*pass)();
+    uint64_t time; // Where this task has got to
+    uint64_t yield;
+};
+
+const int MAX_TASKS   = 4;
+Task      tasks[MAX_TASKS];
+int       taskCount   = 0;
+uint64_t  currentTime  = 0;
+uint64_t  stalledUntil = 0; // End of the latest stallAll()
+bool      inTask       = false;
+
+// The task furthest behind, if any is behind time
+Task* nextTask(uint64_t time)
+{
+    Task* next = nullptr;
+    for (int i = 0; i < taskCount; i++)
+    {
+        if (tasks[i].time < time && (!next || tasks[i].time < next->time))
+            next = &tasks[i];
+    }
+    return next;
+}
+} // namespace
+
+uint64_t sim::now() { return currentTime; }
+
+void sim::advance(uint64_t us)
+{
+    currentTime += us;
+    if (inTask)
+        return;
+
+    // Let the tasks catch up with the main side
+    uint64_t mainTime = currentTime;
+    inTask            = true;
+    while (Task* task = nextTask(mainTime))
+    {
+        currentTime = task->time;
+        task->pass();
+        task->time = currentTime + task->yield;
+        // A stall inside a task holds the main side up too
+        mainTime = std::max(mainTime, stalledUntil);
+    }
+    currentTime = mainTime;
+    inTask      = false;
+}
+
+void sim::stallAll(uint64_t us)
+{
+    // From the main side, the tasks first get as far as the start of the stall.
+    // From a task, the others are already there: the task furthest behind runs.
+    if (!inTask)
+        advance(0);
+
+    uint64_t end = currentTime + us;
+    for (int i = 0; i < taskCount; i++)
+        tasks[i].time = std::max(tasks[i].time, end);
+    stalledUntil = std::max(stalledUntil, end);
+    advance(us);
+}
+
+void sim::startTask(void (*pass)(), uint64_t yieldTime)
+{
+    if (taskCount < MAX_TASKS)
+        tasks[taskCount++] = {pass, currentTime, yieldTime};
+}
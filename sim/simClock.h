@@ -0,0 +1,26 @@
+#pragma once
+// Virtual clock for the host simulator.
+//
+// Nothing in the simulator sleeps. Every simulated peripheral instead advances
+// this clock by the time the real operation would have taken on the board
+// (an ADC conversion, an SPI transfer, a BLE round trip...), which is what lets
+// hours of storm run in seconds.
+//
+// A few tasks can run alongside setup()/loop(), as if on the other core.
+// Whenever the main thread of execution advances the clock, the tasks first run
+// until they have caught up, each with its own time advancing as it goes. A
+// task can't be interrupted by another, so a task that blocks holds the others
+// up, which on the board it wouldn't. An operation that stalls both cores on
+// the board, like a flash erase, uses stallAll() instead, so no side runs
+// until it's over.
+
+#include <cstdint>
+
+namespace sim
+{
+uint64_t now(); // Microseconds since power-on, as seen by whichever side is running
+void     advance(uint64_t us);
+void     stallAll(uint64_t us); // Every side, tasks included, waits out the next us
+
+void startTask(void (*pass)(), uint64_t yieldTime); // pass() is run over and over
+} // namespace sim
@@ -0,0 +1,109 @@
+#include "simDisplay.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "allocGuard.h"
+#include "simClock.h"
+
+namespace
+{
+// ST7789 on a 40MHz SPI bus: 16 bits per pixel plus per-command overhead.
+const double SPI_US_PER_PIXEL = 0.4;
+const double SPI_US_PER_CALL  = 10.0;
+
+// The classic font is 6x8 per glyph, roughly half of which gets drawn.
+const int GLYPH_W          = 6;
+const int GLYPH_H          = 8;
+const int GLYPH_PIXELS_LIT = 20;
+} // namespace
+
+SimDisplay::SimDisplay(int width, int height)
+    : _width(width), _height(height), _pixels(width * height, 0)
+{
+}
+
+void SimDisplay::getTextBounds(const char* text, int16_t x, int16_t y, int16_t* x1, int16_t* y1,
+                               uint16_t* w, uint16_t* h)
+{
+    *x1 = x;
+    *y1 = y;
+    *w  = uint16_t(strlen(text) * GLYPH_W * _textSize);
+    *h  = uint16_t(GLYPH_H * _textSize);
+}
+
+void SimDisplay::fill(int x, int y, int w, int h, uint16_t color)
+{
+    int x0 = std::max(x, 0), x1 = std::min(x + w, _width);
+    int y0 = std::max(y, 0), y1 = std::min(y + h, _height);
+    for (int py = y0; py < y1; py++)
+        std::fill(&_pixels[py * _width + x0], &_pixels[py * _width + std::max(x0, x1)], color);
+}
+
+void SimDisplay::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+    fill(x, y, w, h, color);
+    sim::advance(uint64_t(SPI_US_PER_CALL + w * h * SPI_US_PER_PIXEL));
+
+    eraseText(x, y, w, h);
+}
+
+void SimDisplay::eraseText(int x, int y, int w, int h)
+{
+    // Anything drawn over a piece of text is taken to hide it
+    _texts.erase(std::remove_if(_texts.begin(), _texts.end(),
+                                [&](const Text& t)
+                                {
+                                    return t.x < x + w && x < t.x + t.w && t.y < y + h &&
+                                           y < t.y + t.h;
+                                }),
+                 _texts.end());
+}
+
+void SimDisplay::drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+    fill(x, y, w, 1, color);
+    fill(x, y + h - 1, w, 1, color);
+    fill(x, y, 1, h, color);
+    fill(x + w - 1, y, 1, h, color);
+    sim::advance(uint64_t(4 * SPI_US_PER_CALL + 2 * (w + h) * SPI_US_PER_PIXEL));
+}
+
+size_t SimDisplay::print(const char* text)
+{
+    size_t length = strlen(text);
+    int    cellW  = GLYPH_W * _textSize;
+    int    cellH  = GLYPH_H * _textSize;
+    for (size_t i = 0; i < length; i++)
+    {
+        if (text[i] != ' ')
+            fill(_cursorX + int(i) * cellW, _cursorY, cellW - _textSize, cellH - _textSize,
+                 _textColor);
+        sim::advance(uint64_t(GLYPH_PIXELS_LIT *
+                              (SPI_US_PER_CALL + _textSize * _textSize * SPI_US_PER_PIXEL)));
+    }
+
+    // Keeping track of the text is the simulator's business, not the firmware's
+    allocGuard::Pause notFirmware;
+    eraseText(_cursorX, _cursorY, int(length) * cellW, cellH);
+    _texts.push_back({_cursorX, _cursorY, int(length) * cellW, cellH, text});
+    _cursorX += int(length) * cellW;
+    return length;
+}
+
+bool SimDisplay::writePpm(const char* path) const
+{
+    FILE* file = fopen(path, "wb");
+    if (!file)
+        return false;
+    fprintf(file, "P6\n%d %d\n255\n", _width, _height);
+    for (uint16_t color : _pixels)
+    {
+        uint8_t rgb[3] = {uint8_t((color >> 11) << 3), uint8_t(((color >> 5) & 0x3F) << 2),
+                          uint8_t((color & 0x1F) << 3)};
+        fwrite(rgb, 1, 3, file);
+    }
+    fclose(file);
+    return true;
+}
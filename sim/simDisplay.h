@@ -0,0 +1,56 @@
+#pragma once
+// Framebuffer-backed stand-in for Adafruit_ST7789.
+//
+// Implements the subset of the Adafruit GFX API the firmware draws with. There
+// is no font; each character is drawn as a solid cell the size of the classic
+// 6x8 GFX glyph, and the text itself is kept alongside the pixels so a run can
+// report what was left on screen. Every call advances the virtual clock by
+// roughly what the SPI transfer takes on the board.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class SimDisplay
+{
+  public:
+    SimDisplay(int width, int height);
+
+    void setTextSize(uint8_t size) { _textSize = size; }
+    void setTextColor(uint16_t color) { _textColor = color; }
+    void setCursor(int16_t x, int16_t y)
+    {
+        _cursorX = x;
+        _cursorY = y;
+    }
+    void getTextBounds(const char* text, int16_t x, int16_t y, int16_t* x1, int16_t* y1,
+                       uint16_t* w, uint16_t* h);
+
+    void   fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+    void   drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+    size_t print(const char* text);
+
+    // Simulator side
+    struct Text
+    {
+        int         x, y, w, h;
+        std::string text;
+    };
+    const std::vector<Text>& visibleText() const { return _texts; }
+    uint16_t                 pixel(int x, int y) const { return _pixels[y * _width + x]; }
+    bool                     writePpm(const char* path) const;
+    int                      width() const { return _width; }
+    int                      height() const { return _height; }
+
+  private:
+    void fill(int x, int y, int w, int h, uint16_t color);
+    void eraseText(int x, int y, int w, int h);
+
+    int                   _width, _height;
+    std::vector<uint16_t> _pixels;
+    std::vector<Text>     _texts;
+    uint8_t               _textSize  = 1;
+    uint16_t              _textColor = 0xFFFF;
+    int                   _cursorX   = 0;
+    int                   _cursorY   = 0;
+};
@@ -0,0 +1,32 @@
+#pragma once
+// Simulator side of the HAL backend in halSim.cpp: scripted touch input and
+// what the firmware did with the peripherals.
+
+#include <cstdint>
+
+#include "simDisplay.h"
+
+namespace sim
+{
+void addTap(uint64_t at, uint64_t duration, int x, int y); // Screen coordinates
+
+SimDisplay& screen();
+int         backlightLevel();
+
+struct SensorStats
+{
+    uint64_t samples     = 0;
+    uint64_t firstSample = 0; // us since power-on
+    uint64_t maxGap      = 0; // Longest time between two LDR samples, us
+    uint64_t maxGapAt    = 0; // When it ended
+};
+const SensorStats& sensorStats();
+
+struct FlashStats
+{
+    uint64_t bytesWritten     = 0;
+    uint64_t erases           = 0;
+    uint64_t longestOperation = 0; // us, during which both cores were stalled
+};
+const FlashStats& flashStats();
+} // namespace sim
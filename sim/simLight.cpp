@@ -0,0 +1,118 @@
+#include "simLight.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "simClock.h"
+
+namespace
+{
+const double LDR_RISE_US = 20000.0; // LDRs take tens of milliseconds to respond...
+const double LDR_FALL_US = 30000.0; // ...and longer still to recover
+const double PD_RISE_US  = 5.0;     // A photodiode and its amplifier take microseconds
+const double PD_FALL_US  = 20.0;
+
+const int PD_DARK_COUNTS     = 150; // Amplifier offset
+const int PD_COUNTS_PER_UNIT = 30;  // Photodiode counts per 0..100 reading unit
+
+struct AmbientChange
+{
+    uint64_t at;
+    int      level;
+};
+
+std::vector<sim::Flash>    allFlashes;
+std::vector<AmbientChange> ambientChanges = {{0, 10}};
+bool                       sorted         = false;
+size_t                     ambientIndex   = 0;
+size_t                     firstLive      = 0; // Flashes before this no longer affect the LDR
+uint32_t                   noiseState     = 0x12345678;
+
+double response(const sim::Flash& flash, uint64_t t, double tauRise, double tauFall)
+{
+    double end = double(flash.start + flash.duration);
+    if (t < end)
+        return flash.intensity * (1.0 - exp(-double(t - flash.start) / tauRise));
+    double peak = flash.intensity * (1.0 - exp(-double(flash.duration) / tauRise));
+    return peak * exp(-(t - end) / tauFall);
+}
+
+int noise()
+{
+    // xorshift32, cheap enough to call on every ADC read
+    noiseState ^= noiseState << 13;
+    noiseState ^= noiseState >> 17;
+    noiseState ^= noiseState << 5;
+    return int(noiseState % 17) - 8;
+}
+
+// Light level seen through a sensor with the given time constants.
+double lightLevel(double tauRise, double tauFall)
+{
+    if (!sorted)
+    {
+        auto byStart = [](const sim::Flash& a, const sim::Flash& b) { return a.start < b.start; };
+        std::stable_sort(allFlashes.begin(), allFlashes.end(), byStart);
+        std::stable_sort(ambientChanges.begin(), ambientChanges.end(),
+                         [](const AmbientChange& a, const AmbientChange& b) { return a.at < b.at; });
+        sorted = true;
+    }
+
+    uint64_t t = sim::now();
+    while (ambientIndex + 1 < ambientChanges.size() && ambientChanges[ambientIndex + 1].at <= t)
+        ambientIndex++;
+    while (firstLive < allFlashes.size() &&
+           allFlashes[firstLive].start + allFlashes[firstLive].duration + 10 * LDR_FALL_US < t)
+        firstLive++;
+
+    double level = ambientChanges[ambientIndex].level;
+    for (size_t i = firstLive; i < allFlashes.size() && allFlashes[i].start <= t; i++)
+        level += response(allFlashes[i], t, tauRise, tauFall);
+    return level;
+}
+
+int toCounts(double counts) { return std::min(std::max(int(counts) + noise(), 0), 4095); }
+} // namespace
+
+void sim::addFlash(uint64_t start, uint64_t duration, int intensity)
+{
+    allFlashes.push_back({start, duration, intensity, 0});
+    sorted = false;
+}
+
+void sim::setAmbient(uint64_t at, int level)
+{
+    if (at == 0)
+        ambientChanges[0].level = level;
+    else
+        ambientChanges.push_back({at, level});
+    sorted = false;
+}
+
+void sim::generateStorm(uint64_t duration, double flashesPerMinute, uint32_t seed)
+{
+    if (flashesPerMinute <= 0)
+        return;
+    noiseState = seed | 1;
+
+    std::mt19937                          rng(seed);
+    std::exponential_distribution<double> gap(flashesPerMinute / 60e6);
+    std::uniform_int_distribution<int>    flashMs(50, 500);
+    std::uniform_int_distribution<int>    intensity(20, 90);
+    for (double t = gap(rng); t < duration; t += gap(rng))
+        addFlash(uint64_t(t), uint64_t(flashMs(rng)) * 1000, intensity(rng));
+}
+
+std::vector<sim::Flash>& sim::flashes() { return allFlashes; }
+
+int sim::readLdr()
+{
+    // The firmware maps 0..2000 counts to 100..0
+    return toCounts(2000 - lightLevel(LDR_RISE_US, LDR_FALL_US) * 20);
+}
+
+int sim::readPhotodiode()
+{
+    return toCounts(PD_DARK_COUNTS + lightLevel(PD_RISE_US, PD_FALL_US) * PD_COUNTS_PER_UNIT);
+}
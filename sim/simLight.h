@@ -0,0 +1,29 @@
+#pragma once
+// Scripted light signal seen by the onboard LDR.
+//
+// Light is expressed in the firmware's 0..100 reading units and converted to
+// raw ADC counts on read. The LDR is modelled as a first order response with a
+// few milliseconds of rise time and a slower decay, the photodiode front end
+// as the same with microsecond time constants. Both get a little noise.
+
+#include <cstdint>
+#include <vector>
+
+namespace sim
+{
+struct Flash
+{
+    uint64_t start;      // us
+    uint64_t duration;   // us
+    int      intensity;  // Reading units above ambient
+    uint64_t caughtAt;   // First shot the camera took during the flash, 0 if missed
+};
+
+void addFlash(uint64_t start, uint64_t duration, int intensity);
+void setAmbient(uint64_t at, int level);
+void generateStorm(uint64_t duration, double flashesPerMinute, uint32_t seed);
+
+std::vector<Flash>& flashes(); // Sorted by start time once reading begins
+int                 readLdr();        // Raw ADC counts at the current virtual time
+int                 readPhotodiode(); // Likewise, for the photodiode channel
+} // namespace sim
@@ -0,0 +1,471 @@
+// Host simulator for the lightning trigger firmware.
+//
+// Runs the unmodified setup()/loop() from src/ against simulated peripherals on
+// a virtual clock, then reports loop timing, how many flashes were caught and
+// what was left on screen. See the Simulator section of README.md.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "allocGuard.h"
+#include "lightningDetector.h"
+#include "shotScheduler.h"
+#include "simCamera.h"
+#include "simClock.h"
+#include "simHal.h"
+#include "simLight.h"
+#include "simOptions.h"
+
+void setup();
+void loop();
+extern ShotScheduler shotScheduler;
+
+namespace
+{
+sim::Options simOptions;
+
+uint64_t seconds(double s) { return uint64_t(s * 1e6); }
+
+void usage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --duration <s>       Simulated time to run (default 600)\n"
+            "  --seed <n>           Random seed for the storm and sensor noise (default 1)\n"
+            "  --flash-rate <n>     Random flashes per minute, 0 for none (default 6)\n"
+            "  --ambient <0..100>   Ambient light level (default 10)\n"
+            "  --script <file>      Scenario file with flash/ambient/tap/camera lines\n"
+            "  --screenshot <file>  Write the final framebuffer as a PPM image\n"
+            "  --camera-name <name> Name the simulated camera advertises\n"
+            "  --nvs <file>         Keep the firmware's stored settings in this file\n"
+            "  --flash <file>       Keep the storm log's flash image in this file\n"
+            "  --photodiode         Fit the external photodiode front end\n"
+            "  --save-latencies <file> Write when each flash was caught, for --baseline\n"
+            "  --baseline <file>    Compare each flash's latency with an earlier run's\n"
+            "  --max-extra-latency <ms> With --baseline, fail if a flash near a timelapse\n"
+            "                       photo was lost or caught this much later\n"
+            "  --max-lost <n>       With --baseline, fail if more flashes than this near a\n"
+            "                       timelapse photo were lost, however short\n"
+            "  --quiet              Don't echo the firmware's Serial output\n"
+            "\n"
+            "Trace replay, runs only the lightning detector:\n"
+            "  --trace <file>       CSV of time_us,ldr,photodiode raw ADC counts\n"
+            "  --ldr-threshold <n>  LDR trigger level, 0..100 (default 50)\n"
+            "  --pd-threshold <n>   Photodiode rise above baseline, counts (default 200)\n",
+            program);
+    exit(2);
+}
+
+void parseArguments(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg   = argv[i];
+        auto        value = [&]() -> const char*
+        {
+            if (i + 1 >= argc)
+                usage(argv[0]);
+            return argv[++i];
+        };
+        if (arg == "--duration")
+            simOptions.duration = atof(value());
+        else if (arg == "--seed")
+            simOptions.seed = uint32_t(strtoul(value(), nullptr, 0));
+        else if (arg == "--flash-rate")
+            simOptions.flashesPerMinute = atof(value());
+        else if (arg == "--ambient")
+            simOptions.ambient = atoi(value());
+        else if (arg == "--script")
+            simOptions.script = value();
+        else if (arg == "--screenshot")
+            simOptions.screenshot = value();
+        else if (arg == "--camera-name")
+            simOptions.cameraName = value();
+        else if (arg == "--nvs")
+            simOptions.nvs = value();
+        else if (arg == "--flash")
+            simOptions.flash = value();
+        else if (arg == "--save-latencies")
+            simOptions.saveLatencies = value();
+        else if (arg == "--baseline")
+            simOptions.baseline = value();
+        else if (arg == "--max-extra-latency")
+            simOptions.maxExtraLatency = atof(value());
+        else if (arg == "--max-lost")
+            simOptions.maxLost = atoi(value());
+        else if (arg == "--photodiode")
+            simOptions.photodiode = true;
+        else if (arg == "--trace")
+            simOptions.trace = value();
+        else if (arg == "--ldr-threshold")
+            simOptions.ldrThreshold = float(atof(value()));
+        else if (arg == "--pd-threshold")
+            simOptions.photodiodeThreshold = atoi(value());
+        else if (arg == "--quiet")
+            simOptions.echoSerial = false;
+        else
+            usage(argv[0]);
+    }
+}
+
+// Scenario lines, times in seconds from power-on:
+//   ambient <t> <level>
+//   flash <t> <duration ms> <intensity>
+//   tap <t> <x> <y> [hold ms]
+//   camera <t> on|off|stop
+void loadScript(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        fprintf(stderr, "Can't open script %s\n", path.c_str());
+        exit(2);
+    }
+    std::string line;
+    int         lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream in(line);
+        std::string        command;
+        double             t = 0;
+        if (!(in >> command))
+            continue;
+        bool ok = bool(in >> t);
+        if (ok && command == "ambient")
+        {
+            int level = 0;
+            ok        = bool(in >> level);
+            sim::setAmbient(seconds(t), level);
+        }
+        else if (ok && command == "flash")
+        {
+            double durationMs = 0;
+            int    intensity  = 0;
+            ok                = bool(in >> durationMs >> intensity);
+            sim::addFlash(seconds(t), uint64_t(durationMs * 1000), intensity);
+        }
+        else if (ok && command == "tap")
+        {
+            int    x = 0, y = 0;
+            double holdMs = 100;
+            ok            = bool(in >> x >> y);
+            in >> holdMs;
+            sim::addTap(seconds(t), uint64_t(holdMs * 1000), x, y);
+        }
+        else if (ok && command == "camera")
+        {
+            std::string state;
+            ok = bool(in >> state) && (state == "on" || state == "off" || state == "stop");
+            if (state == "stop")
+                sim::stopCameraRecording(seconds(t));
+            else
+                sim::setCameraPower(seconds(t), state == "on");
+        }
+        else
+            ok = false;
+
+        if (!ok)
+        {
+            fprintf(stderr, "%s:%d: can't parse '%s'\n", path.c_str(), lineNumber, line.c_str());
+            exit(2);
+        }
+    }
+}
+
+// Marks each flash with the first moment the camera captured it, either a
+// shot taken while it was lit or a movie clip running during it.
+void matchShotsToFlashes()
+{
+    const auto& shots = sim::cameraShots();
+    const auto& clips = sim::cameraClips();
+    for (sim::Flash& flash : sim::flashes())
+    {
+        uint64_t flashEnd = flash.start + flash.duration;
+        auto     shot     = std::lower_bound(shots.begin(), shots.end(), flash.start);
+        if (shot != shots.end() && *shot <= flashEnd)
+            flash.caughtAt = *shot;
+        for (const sim::Clip& clip : clips)
+        {
+            if (clip.start > flashEnd || clip.end < flash.start)
+                continue;
+            uint64_t from = std::max(clip.start, flash.start);
+            if (!flash.caughtAt || from < flash.caughtAt)
+                flash.caughtAt = from;
+        }
+    }
+}
+// When the firmware pressed the shutter for each timelapse photo, as it reports
+// them through ShotScheduler's callback.
+std::vector<uint64_t> timelapsePresses;
+
+// Runs in the armed sensing task; the simulator's own bookkeeping doesn't count
+void recordTimelapseShot()
+{
+    allocGuard::Pause simulatorOnly;
+    timelapsePresses.push_back(sim::now());
+}
+
+void saveLatencies(const std::string& path, uint64_t end)
+{
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file)
+    {
+        fprintf(stderr, "Can't write %s\n", path.c_str());
+        return;
+    }
+    for (const sim::Flash& flash : sim::flashes())
+    {
+        if (flash.start < end)
+            fprintf(file, "%llu %llu\n", (unsigned long long)flash.start,
+                    (unsigned long long)flash.caughtAt);
+    }
+    fclose(file);
+}
+
+// Lines the flashes up with the same storm run earlier, typically without the
+// timelapse, and reports how much later they were caught. Flashes within a
+// second of a timelapse shutter press are counted apart from the rest, whose
+// changes are just sensor noise, so the difference is what the timelapse
+// costs. Returns false if a flash near a timelapse photo was caught later than
+// --max-extra-latency allows, or was lost although it stayed lit that long
+// past its catch in the baseline, or if more were lost than --max-lost allows.
+bool compareWithBaseline(const std::string& path, uint64_t end)
+{
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file)
+    {
+        fprintf(stderr, "Can't open baseline %s\n", path.c_str());
+        return false;
+    }
+
+    const std::vector<uint64_t>& timelapse = timelapsePresses;
+    struct Delta
+    {
+        size_t  count = 0, lost = 0, lostInBound = 0;
+        int64_t worst = 0, total = 0;
+    } near, rest;
+    uint64_t bound = uint64_t(std::max(simOptions.maxExtraLatency, 0.0) * 1000);
+    unsigned long long start, caughtAt;
+    auto               flash = sim::flashes().begin();
+    while (fscanf(file, "%llu %llu", &start, &caughtAt) == 2 && flash != sim::flashes().end() &&
+           flash->start == start)
+    {
+        auto   shot  = std::lower_bound(timelapse.begin(), timelapse.end(),
+                                        start - std::min<uint64_t>(start, seconds(1)));
+        Delta& delta = shot != timelapse.end() && *shot <= start + seconds(1) ? near : rest;
+        if (caughtAt && !flash->caughtAt)
+        {
+            delta.lost++;
+            delta.lostInBound += caughtAt + bound < flash->start + flash->duration;
+        }
+        else if (caughtAt && flash->caughtAt)
+        {
+            int64_t extra = int64_t(flash->caughtAt - caughtAt);
+            delta.count++;
+            delta.total += extra;
+            delta.worst = std::max(delta.worst, extra);
+        }
+        ++flash;
+    }
+    fclose(file);
+    if (flash != sim::flashes().end() && flash->start < end)
+    {
+        fprintf(stderr, "Baseline %s is from a different storm\n", path.c_str());
+        return false;
+    }
+
+    printf("Baseline:  %zu flashes within 1 s of a timelapse shot: worst %+.2f ms, mean %+.2f ms, "
+           "%zu lost\n",
+           near.count, near.worst / 1e3, near.count ? near.total / 1e3 / near.count : 0.0,
+           near.lost);
+    printf("           %zu others: worst %+.2f ms, mean %+.2f ms, %zu lost\n", rest.count,
+           rest.worst / 1e3, rest.count ? rest.total / 1e3 / rest.count : 0.0, rest.lost);
+
+    bool passed = true;
+    if (simOptions.maxExtraLatency >= 0 && (near.worst > int64_t(bound) || near.lostInBound))
+    {
+        fprintf(stderr, "FAIL: timelapse made lightning %+.2f ms later and lost %zu flashes "
+                        "that stayed lit %+.2f ms\n",
+                near.worst / 1e3, near.lostInBound, bound / 1e3);
+        passed = false;
+    }
+    if (simOptions.maxLost >= 0 && near.lost > size_t(simOptions.maxLost))
+    {
+        fprintf(stderr, "FAIL: timelapse lost %zu flashes, more than %d\n", near.lost,
+                simOptions.maxLost);
+        passed = false;
+    }
+    return passed;
+}
+
+// Runs the detector over a recorded dual-channel trace and lists each detection
+// with the channel that saw it first, and the photodiode baseline before and
+// after it. The detector counts samples, so each trace line is held and sampled
+// at the sensing loop's rate until the next, whatever rate it was recorded at.
+int replayTrace(const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file)
+    {
+        fprintf(stderr, "Can't open trace %s\n", path.c_str());
+        return 2;
+    }
+
+    LightningDetector detector;
+    detector.setLdrThreshold(simOptions.ldrThreshold);
+    detector.setPhotodiodeThreshold(simOptions.photodiodeThreshold);
+    detector.setPhotodiodeEnabled(simOptions.photodiode);
+
+    const unsigned long long step = 1000000 / LightningDetector::SAMPLES_PER_SECOND;
+
+    char               line[128];
+    unsigned long long t = 0, next = 0, start = 0, samples = 0;
+    int                detections   = 0;
+    int                baseline     = 0; // Photodiode baseline before this detection
+    bool               detecting    = false;
+    bool               held         = false; // current holds a line
+    const char*        firstChannel = "";
+    hal::LightSample   sample, current;
+    auto feed = [&](unsigned long long at) {
+        samples++;
+        bool detected = detector.update(current);
+        if (detected && !detecting)
+        {
+            start        = at;
+            firstChannel = detector.photodiodeDetecting() ? "photodiode" : "ldr";
+            detections++;
+        }
+        else if (!detected && detecting)
+            printf("Detection %.6f s for %.3f ms, first seen by %s, photodiode baseline %d to %d\n",
+                   start / 1e6, (at - start) / 1e3, firstChannel, baseline,
+                   detector.photodiodeBaseline());
+        detecting = detected;
+        if (!detecting)
+            baseline = detector.photodiodeBaseline();
+    };
+    while (fgets(line, sizeof(line), file))
+    {
+        if (sscanf(line, "%llu,%d,%d", &t, &sample.ldr, &sample.photodiode) != 3)
+            continue; // Header or comment
+        if (!held)
+            next = t;
+        for (; held && next < t; next += step)
+            feed(next);
+        current = sample;
+        held    = true;
+    }
+    fclose(file);
+    if (held)
+        feed(next);
+    if (detecting)
+        printf("Detection %.6f s until the end of the trace, first seen by %s\n", start / 1e6,
+               firstChannel);
+    printf("%llu samples, %d detections\n", samples, detections);
+    return 0;
+}
+} // namespace
+
+sim::Options& sim::options() { return simOptions; }
+
+int main(int argc, char** argv)
+{
+    parseArguments(argc, argv);
+    if (!simOptions.trace.empty())
+        return replayTrace(simOptions.trace);
+
+    uint64_t end = seconds(simOptions.duration);
+    sim::setAmbient(0, simOptions.ambient);
+    if (!simOptions.script.empty())
+        loadScript(simOptions.script);
+    sim::generateStorm(end, simOptions.flashesPerMinute, simOptions.seed);
+
+    auto wallStart = std::chrono::steady_clock::now();
+
+    shotScheduler.setTimelapseShotCallback(recordTimelapseShot);
+    setup();
+    uint64_t setupTime = sim::now();
+
+    uint64_t loops = 0, maxLoop = 0, maxLoopAt = 0;
+    while (sim::now() < end)
+    {
+        sim::bleUpdate();
+        uint64_t start = sim::now();
+        loop();
+        uint64_t took = sim::now() - start;
+        if (took > maxLoop)
+        {
+            maxLoop   = took;
+            maxLoopAt = start;
+        }
+        loops++;
+    }
+
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+    matchShotsToFlashes();
+    size_t   caught = 0;
+    uint64_t totalLatency = 0, maxLatency = 0;
+    for (const sim::Flash& flash : sim::flashes())
+    {
+        if (!flash.caughtAt || flash.start >= end)
+            continue;
+        caught++;
+        totalLatency += flash.caughtAt - flash.start;
+        maxLatency = std::max(maxLatency, flash.caughtAt - flash.start);
+    }
+    size_t flashCount = std::count_if(sim::flashes().begin(), sim::flashes().end(),
+                                      [&](const sim::Flash& f) { return f.start < end; });
+
+    const sim::SensorStats& sensor = sim::sensorStats();
+    printf("\n==== Simulation report ====\n");
+    printf("Simulated %.1f s in %.2f s (%.0fx real time)\n", sim::now() / 1e6, wall,
+           sim::now() / 1e6 / std::max(wall, 1e-9));
+    printf("setup():   %.1f ms\n", setupTime / 1e3);
+    printf("loop():    %llu calls, mean %.2f ms, max %.2f ms at %.3f s\n",
+           (unsigned long long)loops, loops ? (sim::now() - setupTime) / 1e3 / loops : 0.0,
+           maxLoop / 1e3, maxLoopAt / 1e6);
+    printf("LDR:       %llu samples from %.1f ms, longest gap %.2f ms at %.3f s\n",
+           (unsigned long long)sensor.samples, sensor.firstSample / 1e3, sensor.maxGap / 1e3,
+           sensor.maxGapAt / 1e6);
+    printf("Flashes:   %zu, caught %zu, missed %zu\n", flashCount, caught, flashCount - caught);
+    if (caught)
+        printf("Latency:   mean %.2f ms, max %.2f ms from flash start to shutter\n",
+               totalLatency / 1e3 / caught, maxLatency / 1e3);
+    uint64_t recorded = 0;
+    for (const sim::Clip& clip : sim::cameraClips())
+        recorded += std::min(clip.end, sim::now()) - std::min(clip.start, sim::now());
+    printf("Camera:    %zu shots, %zu movie clips totalling %.1f s, %d connections\n",
+           sim::cameraShots().size(), sim::cameraClips().size(), recorded / 1e6,
+           sim::cameraConnections());
+    if (shotScheduler.timelapseShots())
+        printf("Timelapse: %lu shots, %lu held for the camera, %lu cut short by lightning\n",
+               (unsigned long)shotScheduler.timelapseShots(),
+               (unsigned long)shotScheduler.timelapseHeld(),
+               (unsigned long)shotScheduler.lightningCutIn());
+    bool passed = simOptions.baseline.empty() || compareWithBaseline(simOptions.baseline, end);
+    if (!simOptions.saveLatencies.empty())
+        saveLatencies(simOptions.saveLatencies, end);
+    const sim::FlashStats& flash = sim::flashStats();
+    printf("Flash:     %llu bytes written, %llu sector erases, longest stall %.2f ms\n",
+           (unsigned long long)flash.bytesWritten, (unsigned long long)flash.erases,
+           flash.longestOperation / 1e3);
+    printf("Screen:   ");
+    for (const SimDisplay::Text& text : sim::screen().visibleText())
+        printf(" [%s]", text.text.c_str());
+    printf("\n");
+
+    if (!simOptions.screenshot.empty() && !sim::screen().writePpm(simOptions.screenshot.c_str()))
+    {
+        fprintf(stderr, "Can't write %s\n", simOptions.screenshot.c_str());
+        return 1;
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,34 @@
+#pragma once
+// Command line options of the host simulator, shared by its modules.
+
+#include <cstdint>
+#include <string>
+
+namespace sim
+{
+struct Options
+{
+    double      duration         = 600.0; // Simulated seconds to run
+    uint32_t    seed             = 1;     // For the storm generator and sensor noise
+    double      flashesPerMinute = 6.0;   // Random storm; 0 to only use the script
+    int         ambient          = 10;    // Ambient light, in the firmware's 0..100 units
+    bool        echoSerial       = true;  // Print the firmware's Serial output
+    bool        photodiode       = false; // Fit the external photodiode front end
+    std::string script;                   // Scenario file, see README.md
+    std::string screenshot;               // Framebuffer written here as a PPM at the end
+    std::string nvs;                      // Settings storage file, kept across runs
+    std::string flash;                    // Storm log flash image, kept across runs
+    std::string saveLatencies;            // Each flash's start and catch time written here
+    std::string baseline;                 // Written by an earlier run, to compare against
+    double      maxExtraLatency  = -1.0;  // ms the timelapse may add to a flash; < 0 to not check
+    int         maxLost          = -1;    // Flashes the timelapse may lose; < 0 to not check
+    std::string cameraName = "ILCE-7CM2";
+
+    // Trace replay: run only the LightningDetector over a recorded trace
+    std::string trace;
+    float       ldrThreshold        = 50.0f;
+    int         photodiodeThreshold = 200;
+};
+
+Options& options();
+} // namespace sim
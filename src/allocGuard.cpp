@@ -0,0 +1,132 @@
+#ifdef ALLOC_GUARD
+
+#include "allocGuard.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifndef SIMULATOR
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+extern "C" void* __real_malloc(size_t size);
+extern "C" void* __real_calloc(size_t count, size_t size);
+extern "C" void* __real_realloc(void* ptr, size_t size);
+
+namespace
+{
+struct WatchedTask
+{
+    void* handle;
+    int   pauseDepth;
+};
+
+const int             MAX_WATCHED  = 2;
+WatchedTask           watched[MAX_WATCHED];
+int                   watchedCount = 0;
+std::atomic<uint32_t> allocations{0}; // Counted from the sensing task and loop() at once
+
+void* currentTask()
+{
+#ifdef SIMULATOR
+    return nullptr; // The simulator is single threaded
+#else
+    return xTaskGetCurrentTaskHandle();
+#endif
+}
+
+WatchedTask* watchedTask()
+{
+    if (watchedCount == 0)
+        return nullptr;
+    void* task = currentTask();
+    for (int i = 0; i < watchedCount; i++)
+    {
+        if (watched[i].handle == task)
+            return &watched[i];
+    }
+    return nullptr;
+}
+
+void countAllocation()
+{
+    WatchedTask* task = watchedTask();
+    if (task && task->pauseDepth == 0)
+        allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void* allocate(size_t size)
+{
+    countAllocation();
+    void* ptr = __real_malloc(size ? size : 1);
+    if (!ptr)
+        abort();
+    return ptr;
+}
+} // namespace
+
+void allocGuard::watchThisTask()
+{
+    if (watchedTask() || watchedCount == MAX_WATCHED)
+        return;
+    watched[watchedCount] = {currentTask(), 0};
+    watchedCount++;
+}
+
+uint32_t allocGuard::count() { return allocations.load(std::memory_order_relaxed); }
+
+allocGuard::Pause::Pause() : _task(watchedTask())
+{
+    if (_task)
+        static_cast<WatchedTask*>(_task)->pauseDepth++;
+}
+
+allocGuard::Pause::~Pause()
+{
+    if (_task)
+        static_cast<WatchedTask*>(_task)->pauseDepth--;
+}
+
+// ================================================
+// Allocation hooks
+
+extern "C" void* __wrap_malloc(size_t size)
+{
+    countAllocation();
+    return __real_malloc(size);
+}
+
+extern "C" void* __wrap_calloc(size_t count, size_t size)
+{
+    countAllocation();
+    return __real_calloc(count, size);
+}
+
+extern "C" void* __wrap_realloc(void* ptr, size_t size)
+{
+    countAllocation();
+    return __real_realloc(ptr, size);
+}
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    countAllocation();
+    return __real_malloc(size ? size : 1);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    countAllocation();
+    return __real_malloc(size ? size : 1);
+}
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { free(ptr); }
+
+#endif // ALLOC_GUARD
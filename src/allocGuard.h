@@ -0,0 +1,42 @@
+#pragma once
+// Heap allocation guard.
+//
+// Once armed, the firmware should run without touching the heap: allocations
+// fragment it over a night of running, and can stall for unpredictable times.
+// In builds with ALLOC_GUARD defined, this counts every allocation made by the
+// watched tasks (the sensing task and the one running loop()), so a check can
+// catch any that creep in. These builds also need malloc, calloc and realloc
+// wrapped at link time:
+//   -DALLOC_GUARD -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc
+// The simulator and the -debug board environment are built this way. In
+// other builds everything here compiles away.
+
+#include <cstdint>
+
+namespace allocGuard
+{
+#ifdef ALLOC_GUARD
+void     watchThisTask(); // Count allocations made by the calling task from now on (up to 2)
+uint32_t count();         // Allocations counted so far
+
+// Stops counting while in scope. For calls into code whose allocations are out
+// of our hands, like the BLE stack when a command is sent.
+class Pause
+{
+  public:
+    Pause();
+    ~Pause();
+
+  private:
+    void* _task;
+};
+#else
+inline void     watchThisTask() {}
+inline uint32_t count() { return 0; }
+class Pause
+{
+  public:
+    Pause() {}
+};
+#endif
+} // namespace allocGuard
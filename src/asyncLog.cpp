@@ -0,0 +1,130 @@
+#include "asyncLog.h"
+
+#include <Arduino.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+#include "hal.h"
+#include "mpscRing.h"
+
+namespace
+{
+const char* const FORMATS[] = {
+#define LOG_MESSAGE_FORMAT(id, format) format,
+    LOG_MESSAGES(LOG_MESSAGE_FORMAT)
+#undef LOG_MESSAGE_FORMAT
+};
+
+const size_t TEXT_SIZE = 16;
+
+struct Record
+{
+    asyncLog::Message message;
+    uint32_t          time; // millis(), which only wraps after 49 days
+    int32_t           args[4];
+    char              text[TEXT_SIZE];
+};
+
+MpscRing<Record, 64>  ring;
+std::atomic<uint32_t> droppedCount{0};
+
+void push(Record& record, asyncLog::Message message, int32_t a, int32_t b, int32_t c, int32_t d)
+{
+    record.message = message;
+    record.time    = millis();
+    record.args[0] = a;
+    record.args[1] = b;
+    record.args[2] = c;
+    record.args[3] = d;
+    if (!ring.push(record))
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+// ================================================
+// Drain
+
+char     line[160];
+size_t   lineLength   = 0;
+size_t   lineSent     = 0;
+uint32_t droppedShown = 0;
+
+// Formats the next message into line. Returns false if there is none.
+bool formatNext()
+{
+    Record record;
+    if (!ring.pop(record))
+    {
+        // Caught up, so any drops came after everything printed so far
+        uint32_t dropped = droppedCount.load(std::memory_order_relaxed);
+        if (dropped == droppedShown)
+            return false;
+        lineLength   = snprintf(line, sizeof(line), "Log: %lu messages dropped\n",
+                                (unsigned long)(dropped - droppedShown));
+        droppedShown = dropped;
+        return true;
+    }
+
+    // Timestamped when logged, which may be a while before it's printed
+    int length = snprintf(line, sizeof(line), "%lu.%03lu ", (unsigned long)(record.time / 1000),
+                          (unsigned long)(record.time % 1000));
+
+    // Unused arguments on the end are harmless to printf
+    const char* format = FORMATS[record.message];
+    char*       text   = line + length;
+    size_t      room   = sizeof(line) - length - 1; // Leave room for the newline
+    long        a      = record.args[0];
+    long        b      = record.args[1];
+    long        c      = record.args[2];
+    long        d      = record.args[3];
+    if (strstr(format, "%s"))
+        length += snprintf(text, room, format, record.text, a, b, c, d);
+    else
+        length += snprintf(text, room, format, a, b, c, d);
+    lineLength = std::min(size_t(length), sizeof(line) - 2);
+    line[lineLength++] = '\n';
+    return true;
+}
+
+void drainPass()
+{
+    for (;;)
+    {
+        if (lineSent == lineLength)
+        {
+            lineSent = lineLength = 0;
+            if (!formatNext())
+                return;
+        }
+
+        // Only ever write what the UART FIFO can take, so the drain never blocks
+        size_t room = Serial.availableForWrite();
+        if (room == 0)
+            return;
+        size_t length = std::min(room, lineLength - lineSent);
+        Serial.write(line + lineSent, length);
+        lineSent += length;
+    }
+}
+} // namespace
+
+void asyncLog::write(Message message, int32_t a, int32_t b, int32_t c, int32_t d)
+{
+    Record record;
+    record.text[0] = '\0';
+    push(record, message, a, b, c, d);
+}
+
+void asyncLog::write(Message message, const char* text, int32_t a, int32_t b, int32_t c,
+                     int32_t d)
+{
+    Record record;
+    strncpy(record.text, text, TEXT_SIZE - 1);
+    record.text[TEXT_SIZE - 1] = '\0';
+    push(record, message, a, b, c, d);
+}
+
+void asyncLog::startDrainTask() { hal::startBackgroundTask(drainPass); }
+
+uint32_t asyncLog::dropped() { return droppedCount.load(std::memory_order_relaxed); }
@@ -0,0 +1,98 @@
+#pragma once
+// Deferred logging, to keep Serial off the time critical paths.
+//
+// At 115200 baud the UART takes 87us a byte, and Serial.print() blocks once
+// its small FIFO is full. So instead of formatting and printing on the spot, a
+// log call only copies a message ID, a timestamp and a few arguments into a
+// lock-free ring, which takes a few cycles and never blocks. A low priority
+// task formats the messages and drains them to Serial, only ever writing what
+// the FIFO can take. If the ring fills up, new messages are dropped and
+// counted; the drain reports how many were lost.
+//
+// Every message is declared once in LOG_MESSAGES below, with its printf
+// format. Integer arguments are printed with %ld; a message can also carry one
+// short string, which comes first and is printed with %s (longer strings are
+// cut short).
+//
+// The level is chosen at compile time, e.g. -DLOG_LEVEL=LOG_LEVEL_DEBUG in
+// platformio.ini. Calls below it compile away, arguments and all.
+
+#include <cstdint>
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_MESSAGES(X)                                                                     \
+    X(Boot,               "Boot (%s): settings %ld, sensing %ld, display %ld, BLE %ld ms")  \
+    X(Connecting,         "Connecting to camera...")                                        \
+    X(TriggerFired,       "Trigger fired at %ld")                                           \
+    X(BleFound,           "BLE: something found: %s")                                       \
+    X(BleCameraFound,     "Camera found. Connecting!")                                      \
+    X(BleReadyToPair,     "Camera is ready to pair")                                        \
+    X(BleNotReadyToPair,  "Camera is not ready to pair, but trying to connect")             \
+    X(BleConnected,       "Connected")                                                      \
+    X(BleDisconnected,    "Disconnected")                                                   \
+    X(BlePassKeyRequest,  "PassKeyRequest")                                                 \
+    X(BlePassKeyNotify,   "The passkey Notify number: %ld")                                 \
+    X(BleSecurityRequest, "SecurityRequest")                                                \
+    X(BleAuthComplete,    "Authentication Complete, pairing %s")                            \
+    X(BleServerConnected, " - Connected to server")                                         \
+    X(BleNoService,       "Failed to find our service UUID")                                \
+    X(BleNoCommand,       "Failed to find our characteristic command")                      \
+    X(BleNoNotify,        "Failed to find our characteristic notify")                       \
+    X(BleServiceFound,    "Camera BLE service and characteristic found")                    \
+    X(BleConnectFailed,   " - fail to BLE connect")                                         \
+    X(BleScanStart,       "BLE: Looking for camera")                                        \
+    X(BleScanEnd,         "BLE: end of searching")                                          \
+    X(BleTookPhoto,       "BLE: took photo")                                                \
+    X(BleRecordingStart,  "BLE: recording started")                                         \
+    X(BleRecordingStop,   "BLE: recording stopped")                                         \
+    X(BleCameraRecording, "Camera: recording %s")
+
+namespace asyncLog
+{
+enum Message : uint16_t
+{
+#define LOG_MESSAGE_ID(id, format) id,
+    LOG_MESSAGES(LOG_MESSAGE_ID)
+#undef LOG_MESSAGE_ID
+};
+
+void write(Message message, int32_t a = 0, int32_t b = 0, int32_t c = 0, int32_t d = 0);
+void write(Message message, const char* text, int32_t a = 0, int32_t b = 0, int32_t c = 0,
+           int32_t d = 0);
+
+void     startDrainTask();
+uint32_t dropped(); // Messages lost to a full ring so far
+} // namespace asyncLog
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(message, ...) asyncLog::write(asyncLog::message, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(message, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(message, ...) asyncLog::write(asyncLog::message, ##__VA_ARGS__)
+#else
+#define LOG_WARN(message, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(message, ...) asyncLog::write(asyncLog::message, ##__VA_ARGS__)
+#else
+#define LOG_INFO(message, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(message, ...) asyncLog::write(asyncLog::message, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(message, ...) ((void)0)
+#endif
@@ -0,0 +1,74 @@
+#pragma once
+// Hardware abstraction layer for the CYD 2432S024.
+//
+// The application in main.cpp only reaches the board's peripherals (light
+// sensors, touch, display, backlight, tasks and settings storage) through the
+// functions below. On the
+// board they are implemented in halEsp32.cpp; the host simulator in sim/
+// provides its own implementations driven by a virtual clock, so the same
+// setup()/loop() can run on a PC.
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef SIMULATOR
+#include "simDisplay.h"
+using Display = SimDisplay;
+#else
+#include <Adafruit_ST7789.h>
+using Display = Adafruit_ST7789;
+#endif
+
+#define RES_X 240
+#define RES_Y 320
+
+namespace hal
+{
+void init();        // LEDs, ADC and SPI bus
+void initDisplay(); // Panel init, in portrait with the light sensor at the top right
+void initTouch();
+
+Display& display();
+
+struct LightSample
+{
+    int ldr;        // Onboard LDR, raw ADC counts 0..4095. Lower means brighter.
+    int photodiode; // External photodiode front end, 0..4095. Higher means brighter.
+};
+
+// True if the board has a photodiode front end wired up next to the LDR.
+bool hasPhotodiode();
+
+// Samples every fitted light channel in one back to back pass.
+void readLightSensors(LightSample& sample);
+
+// Returns true and the touch position in screen coordinates while touched.
+bool readTouch(int& x, int& y);
+
+void setBacklight(uint8_t level);
+
+// Runs pass() over and over in its own task on the other core from loop(),
+// yielding for a tick between passes.
+void startSensingTask(void (*pass)());
+
+// Runs pass() over and over in its own task on loop()'s core, sleeping for 10ms
+// between passes. It has loop()'s priority and shares the core by time slice:
+// any lower and it would never run, since loop() never sleeps.
+void startBackgroundTask(void (*pass)());
+
+// A blob of settings in non-volatile storage. loadSettings() returns false if
+// nothing of that size has been stored yet.
+bool loadSettings(void* data, size_t size);
+void saveSettings(const void* data, size_t size);
+
+// Raw flash for the storm log, in erase sectors of LOG_FLASH_SECTOR bytes.
+// Offsets are from its start; logFlashSize() is 0 if there's none. Erased flash
+// reads 0xFF, and a write can only clear bits. While an erase or a write is in
+// progress, the flash cache is off and both cores stall.
+const size_t LOG_FLASH_SECTOR = 4096;
+
+size_t logFlashSize();
+void   readLogFlash(size_t offset, void* data, size_t size);
+void   writeLogFlash(size_t offset, const void* data, size_t size);
+void   eraseLogFlashSector(size_t offset);
+} // namespace hal
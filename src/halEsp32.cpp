@@ -0,0 +1,280 @@
+// ESP32 implementation of the hardware abstraction layer (see hal.h).
+//
+// Automatic config of touch hw depending from board environement choice in
+// platform.ini
+//
+// Touch screen support is derived from Mike Eitel's ESP32_CYD_MQTT project.
+// https://github.com/MikeEitel/ESP-32_CYD_MQTT
+
+#ifdef ESP32_2432S024N
+#define LCDtypeN
+#elif ESP32_2432S024C
+#define LCDtypeC
+#elif ESP32_2432S024R
+#define LCDtypeR
+#endif
+
+#include "hal.h"
+
+#include <Adafruit_GFX.h>
+#include <Arduino.h>
+#include <Preferences.h>
+#include <SPI.h>
+#include <driver/adc.h>
+#include <esp_partition.h>
+
+#if defined(LCDtypeC)
+#include <bb_captouch.h>
+#elif defined(LCDtypeR)
+#include "XPT2046_Touchscreen.h" // Adapted Adafruit with permanant change to HSPI
+#endif
+
+// CYD uses HSPI and even same pins for screen and XPT2046 chip !!!
+#define HSPI_MISO 12 // GPIO pin for HSPI MISO
+#define HSPI_MOSI 13 // GPIO pin for HSPI MOSI
+#define HSPI_SCK 14  // GPIO pin for HSPI clock
+#define HSPI_SS 15   // GPIO pin for HSPI SS (slave select)
+
+// Define used pins of the LCD
+#define CYD_RST -1 // org -1 but if needed probably unused pin 23 used
+#define CYD_DC 2
+#define CYD_MISO HSPI_MISO // 12
+#define CYD_MOSI HSPI_MOSI // 13
+#define CYD_SCLK HSPI_SCK  // 14
+#define CYD_CS 15          // Chip select for screen
+#define CYD_BL 27          // The display backlight
+#define CYD_LDR 34         // The ldr light sensor.
+
+// External photodiode/transimpedance front end on the P3 connector. Uncomment
+// if one is fitted; its output should swing 0..3.1V and rise with light.
+// #define CYD_PD 35
+
+#define CYD_LDR_CHANNEL ADC1_CHANNEL_6 // GPIO34
+#define CYD_PD_CHANNEL ADC1_CHANNEL_7  // GPIO35
+
+#if defined(LCDtypeC) // These are for the capacitive touch version
+#define CST820_SDA 33
+#define CST820_SCL 32
+#define CST820_RST -1 // 25
+#define CST820_IRQ -1 // 21
+// Define touch areas on screen
+const int XTmin = 1;     // measured values from touch upper left corner
+const int XTmax = RES_Y; // measured values from touch lower right corner
+const int YTmin = 1;     // measured values from touch upper left corner
+const int YTmax = RES_X; // measured values from touch lower right corner
+
+#elif defined(LCDtypeR)        // These are for the capacitive touch version
+// Problem with standard libs as only one SPI is used -> special CYD_xxx lib needed
+#define XPT2046_IRQ 36         // Unused interupt pin
+#define XPT2046_MOSI HSPI_MOSI // 13 // diffrent from CYD source = 32
+#define XPT2046_MISO HSPI_MISO // 12 // diffrent from CYD source = 39
+#define XPT2046_SCLK HSPI_SCK  // 14 // diffrent from CYD source = 25
+#define XPT2046_CS 33          // Chip select for touch
+// Define touch areas on screen
+const int XTmin = 57;   // measured values from touch upper left corner
+const int XTmax = 3788; // measured values from touch lower right corner
+const int YTmin = 3911; // measured values from touch upper left corner
+const int YTmax = 299;  // measured values from touch lower right corner
+#endif
+
+// Onboard led
+#define CYD_LED_RED 4    // The all in one led defining the lower left corner
+#define CYD_LED_GREEN 16 // All in one led
+#define CYD_LED_BLUE 17  // All in one led
+#define LED_ON LOW
+#define LED_OFF HIGH
+
+namespace
+{
+Adafruit_ST7789 cyd = Adafruit_ST7789(
+    CYD_CS, CYD_DC, CYD_RST); // When resistive touch below software spi is not usable !
+
+#if defined(LCDtypeC)
+BBCapTouch  touch;
+TOUCHINFO   ti;
+const char* szNames[] = {"Unknown", "FT6x36", "GT911", "CST820"};
+#elif defined(LCDtypeR)
+XPT2046_Touchscreen touchHW(XPT2046_CS);
+#endif
+
+Preferences preferences;
+
+// The storm log takes over the spiffs partition of the standard partition
+// tables, which nothing else here uses.
+const esp_partition_t* logPartition()
+{
+    static const esp_partition_t* partition = esp_partition_find_first(
+        ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, nullptr);
+    return partition;
+}
+
+// Each task is handed its own pass function as the task parameter.
+typedef void (*TaskPass)();
+
+void sensingTask(void* parameter)
+{
+    TaskPass pass = reinterpret_cast<TaskPass>(parameter);
+    for (;;)
+    {
+        pass();
+        vTaskDelay(1); // Let the idle task in, or the watchdog bites
+    }
+}
+
+void backgroundTask(void* parameter)
+{
+    TaskPass pass = reinterpret_cast<TaskPass>(parameter);
+    for (;;)
+    {
+        pass();
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+
+bool getRawTouch(int& x, int& y)
+{
+#if defined(LCDtypeR) // Resistive
+    if (!touchHW.touched())
+        return false;
+
+    TS_Point p = touchHW.getPoint();
+    x          = p.x;
+    y          = p.y;
+    return true;
+#elif defined(LCDtypeC) // Capacitive
+    if (!touch.getSamples(&ti))
+        return false;
+    x = ti.y[0];
+    y = ti.x[0];
+    return true;
+#else
+    return false;
+#endif
+}
+} // namespace
+
+void hal::init()
+{
+    pinMode(CYD_LED_BLUE, OUTPUT);
+    pinMode(CYD_LED_GREEN, OUTPUT);
+    pinMode(CYD_LED_RED, OUTPUT);
+    digitalWrite(CYD_LED_RED, LED_OFF);
+    digitalWrite(CYD_LED_GREEN, LED_OFF);
+    digitalWrite(CYD_LED_BLUE, LED_OFF);
+
+    adc1_config_width(ADC_WIDTH_BIT_12);
+    adc1_config_channel_atten(CYD_LDR_CHANNEL, ADC_ATTEN_DB_0); // Needs maximum sensitivity.
+#ifdef CYD_PD
+    adc1_config_channel_atten(CYD_PD_CHANNEL, ADC_ATTEN_DB_11); // Full range
+#endif
+
+    SPI.begin(HSPI_SCK, HSPI_MISO, HSPI_MOSI);
+
+    pinMode(CYD_BL, OUTPUT);
+}
+
+void hal::initDisplay()
+{
+    cyd.init(RES_X, RES_Y);
+    cyd.invertDisplay(false);
+    cyd.setRotation(2); // Light sensor is at top right
+}
+
+void hal::initTouch()
+{
+#if defined(LCDtypeC)
+    touch.init(CST820_SDA, CST820_SCL, CST820_RST,
+               CST820_IRQ); // sda, scl, rst, irq
+    int iType = touch.sensorType();
+    Serial.printf("Sensor type = %s\n", szNames[iType]);
+#elif defined LCDtypeR
+    touchHW.begin();
+    touchHW.setRotation(3); // Light sensor is at top right
+#endif
+}
+
+Display& hal::display() { return cyd; }
+
+bool hal::hasPhotodiode()
+{
+#ifdef CYD_PD
+    return true;
+#else
+    return false;
+#endif
+}
+
+void hal::readLightSensors(LightSample& sample)
+{
+    // Both channels are on ADC1, converted back to back with the raw driver
+    // calls, which skip the per-call pin setup and calibration of analogRead().
+    sample.ldr = adc1_get_raw(CYD_LDR_CHANNEL);
+#ifdef CYD_PD
+    sample.photodiode = adc1_get_raw(CYD_PD_CHANNEL);
+#else
+    sample.photodiode = 0;
+#endif
+}
+
+bool hal::readTouch(int& x, int& y)
+{
+    int xRaw = 0;
+    int yRaw = 0;
+    if (!getRawTouch(xRaw, yRaw))
+        return false;
+
+    x = map(xRaw, XTmin, XTmax, 0, RES_X);
+    y = map(yRaw, YTmin, YTmax, 0, RES_Y);
+    x = constrain(x, 0, RES_X);
+    y = constrain(y, 0, RES_Y);
+    return true;
+}
+
+void hal::setBacklight(uint8_t level) { analogWrite(CYD_BL, level); }
+
+void hal::startSensingTask(void (*pass)())
+{
+    // Core 0, next to the BLE stack, which leaves core 1 to loop() and the UI.
+    xTaskCreatePinnedToCore(sensingTask, "sensing", 4096, reinterpret_cast<void*>(pass), 2,
+                            nullptr, 0);
+}
+
+void hal::startBackgroundTask(void (*pass)())
+{
+    // Same priority as loop(), which never sleeps, so they share core 1 by time slice.
+    xTaskCreatePinnedToCore(backgroundTask, "background", 4096, reinterpret_cast<void*>(pass), 1,
+                            nullptr, 1);
+}
+
+bool hal::loadSettings(void* data, size_t size)
+{
+    preferences.begin("trigger", true);
+    bool found = preferences.getBytesLength("settings") == size &&
+                 preferences.getBytes("settings", data, size) == size;
+    preferences.end();
+    return found;
+}
+
+void hal::saveSettings(const void* data, size_t size)
+{
+    preferences.begin("trigger", false);
+    preferences.putBytes("settings", data, size);
+    preferences.end();
+}
+
+size_t hal::logFlashSize() { return logPartition() ? logPartition()->size : 0; }
+
+void hal::readLogFlash(size_t offset, void* data, size_t size)
+{
+    esp_partition_read(logPartition(), offset, data, size);
+}
+
+void hal::writeLogFlash(size_t offset, const void* data, size_t size)
+{
+    esp_partition_write(logPartition(), offset, data, size);
+}
+
+void hal::eraseLogFlashSector(size_t offset)
+{
+    esp_partition_erase_range(logPartition(), offset, LOG_FLASH_SECTOR);
+}
@@ -0,0 +1,56 @@
+#include "lightningDetector.h"
+
+void LightningDetector::setPhotodiodeEnabled(bool enabled)
+{
+    _photodiodeEnabled  = enabled;
+    _photodiodeEvent    = false;
+    _photodiodeBaseline = -1;
+}
+
+bool LightningDetector::update(const hal::LightSample& sample)
+{
+    // The LDR maps 0..2000 counts to 100..0
+    int reading = 100 - sample.ldr / 20;
+    _ldrReading = reading < 0 ? 0 : reading;
+
+    // A little hysteresis, so noise at the threshold doesn't chop up a flash
+    if (_ldrReading > _ldrThreshold)
+        _ldrEvent = true;
+    else if (_ldrReading < _ldrThreshold - LDR_HYSTERESIS)
+        _ldrEvent = false;
+
+    bool detected = _ldrEvent;
+    if (_photodiodeEnabled)
+        detected = updatePhotodiode(sample.photodiode) || detected;
+    return detected;
+}
+
+bool LightningDetector::updatePhotodiode(int counts)
+{
+    if (_photodiodeBaseline < 0)
+        _photodiodeBaseline = int64_t(counts) << BASELINE_SHIFT;
+
+    int rise = counts - photodiodeBaseline();
+    if (_photodiodeEvent)
+    {
+        // Hysteresis, so a flickering flash stays a single event
+        if (rise < _photodiodeThreshold / 2)
+            _photodiodeEvent = false;
+        else if (++_eventSamples > MAX_EVENT_SAMPLES)
+        {
+            // Bright for this long isn't lightning, it's the new ambient
+            _photodiodeEvent    = false;
+            _photodiodeBaseline = int64_t(counts) << BASELINE_SHIFT;
+        }
+    }
+    else if (rise > _photodiodeThreshold)
+    {
+        _photodiodeEvent = true;
+        _eventSamples    = 0;
+    }
+
+    // Hold the baseline during a flash so it isn't averaged into the ambient
+    if (!_photodiodeEvent)
+        _photodiodeBaseline += counts - (_photodiodeBaseline >> BASELINE_SHIFT);
+    return _photodiodeEvent;
+}
@@ -0,0 +1,56 @@
+#pragma once
+// Lightning detection from the light sensors.
+//
+// Fuses the two light channels:
+//  - The onboard LDR is slow (milliseconds to respond) but gives the ambient
+//    light level in the 0..100 units shown on screen. It drives the auto
+//    sensitivity, and on its own triggers when the reading goes above it.
+//  - The optional photodiode front end responds in microseconds, so when it's
+//    fitted it gives the flash's leading edge. It triggers when it rises more
+//    than its threshold above a slowly tracked baseline.
+// Either channel detecting counts as a detection.
+//
+// This is plain logic with no hardware access, so the simulator can also run
+// it over recorded dual-channel traces.
+
+#include <cstdint>
+
+#include "hal.h"
+
+class LightningDetector
+{
+  public:
+    void setLdrThreshold(float reading) { _ldrThreshold = reading; }
+    void setPhotodiodeThreshold(int counts) { _photodiodeThreshold = counts; }
+    void setPhotodiodeEnabled(bool enabled);
+
+    // Feed one sample of both channels. Returns true while a flash is detected.
+    bool update(const hal::LightSample& sample);
+
+    int  ldrReading() const { return _ldrReading; } // 0..100, higher is brighter
+    bool ldrDetecting() const { return _ldrEvent; }
+    int  photodiodeBaseline() const { return int(_photodiodeBaseline >> BASELINE_SHIFT); }
+    bool photodiodeDetecting() const { return _photodiodeEvent; }
+
+    // The photodiode's timings below count samples, assuming the sensing loop's
+    // rate with the photodiode fitted: two ADC conversions of about 9us each,
+    // plus the loop around them.
+    static const uint32_t SAMPLES_PER_SECOND = 50000;
+
+  private:
+    bool updatePhotodiode(int counts);
+
+    // The baseline is an exponential average over 2^BASELINE_SHIFT samples, 1.3s
+    static const int      BASELINE_SHIFT    = 16;
+    static const uint32_t MAX_EVENT_SAMPLES = SAMPLES_PER_SECOND; // Stop holding the baseline after 1s
+    static const int      LDR_HYSTERESIS    = 2;                  // Reading units
+
+    float    _ldrThreshold        = 50.0f;
+    int      _ldrReading          = 0;
+    bool     _ldrEvent            = false;
+    bool     _photodiodeEnabled   = false;
+    int      _photodiodeThreshold = 200;
+    bool     _photodiodeEvent     = false;
+    uint32_t _eventSamples        = 0;
+    int64_t  _photodiodeBaseline  = -1; // Fixed point, shifted by BASELINE_SHIFT
+};
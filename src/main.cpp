@@ -3,8 +3,8 @@
 // Tested with resistive touch. Capacitive touch is not tested but should work
 // with some calibration and appropriate libraries.
 //
-// Automatic config of touch hw depending from board environement choice in
-// platform.ini
+// Board specific code (pins, display and touch) lives behind hal.h, so this
+// file also runs unmodified in the host simulator under sim/.
 //
 // Portions of this file, most importantly touch screen support, are derived
 // from Mike Eitel's ESP32_CYD_MQTT project, which served as the gateway to
@@ -12,34 +12,23 @@
 // https://github.com/MikeEitel/ESP-32_CYD_MQTT
 //
 
-#ifdef ESP32_2432S024N
-#define LCDtypeN
-#elif ESP32_2432S024C
-#define LCDtypeC
-#elif ESP32_2432S024R
-#define LCDtypeR
-#endif
-
 // #define TEST_UI_ONLY // Define to test UI only without camera connected
 
 // Needed standard libraries
-#include <Adafruit_GFX.h>
-#include <Adafruit_ST7789.h>
 #include <Arduino.h>
-#include <SPI.h>
-#include <WiFi.h>
+#include <algorithm>
+#include <climits>
 #include <cstdint>
-#include <driver/adc.h>
-#include <gfxfont.h>
+#include <cstdio>
 #include <vector>
 
+#include "allocGuard.h"
+#include "asyncLog.h"
+#include "hal.h"
+#include "lightningDetector.h"
+#include "shotScheduler.h"
 #include "sonyBluetoothRemote.h"
-
-#if defined(LCDtypeC)
-#include <bb_captouch.h>
-#elif defined(LCDtypeR)
-#include "XPT2046_Touchscreen.h" // Adapted Adafruit with permanant change to HSPI
-#endif
+#include "stormLog.h"
 
 // Convert 888 24-bit RGB to 565 16-bit color
 constexpr uint16_t rgb565(int r, int g, int b)
@@ -67,57 +56,6 @@ constexpr uint16_t rgb565(int r, int g, int b)
 #define COL_GREENYELLOW rgb565(173, 255, 41)
 #define COL_PINK rgb565(255, 130, 198)
 
-// CYD uses HSPI and even same pins for screen and XPT2046 chip !!!
-#define HSPI_MISO 12 // GPIO pin for HSPI MISO
-#define HSPI_MOSI 13 // GPIO pin for HSPI MOSI
-#define HSPI_SCK 14  // GPIO pin for HSPI clock
-#define HSPI_SS 15   // GPIO pin for HSPI SS (slave select)
-
-// Define used pins of the LCD
-#define CYD_RST -1 // org -1 but if needed probably unused pin 23 used
-#define CYD_DC 2
-#define CYD_MISO HSPI_MISO // 12
-#define CYD_MOSI HSPI_MOSI // 13
-#define CYD_SCLK HSPI_SCK  // 14
-#define CYD_CS 15          // Chip select for screen
-#define CYD_BL 27          // The display backlight
-#define CYD_LDR 34         // The ldr light sensor.
-
-#define RES_X 240
-#define RES_Y 320
-
-#if defined(LCDtypeC) // These are for the capacitive touch version
-#define CST820_SDA 33
-#define CST820_SCL 32
-#define CST820_RST -1 // 25
-#define CST820_IRQ -1 // 21
-// Define touch areas on screen
-const int XTmin = 1;     // measured values from touch upper left corner
-const int XTmax = RES_Y; // measured values from touch lower right corner
-const int YTmin = 1;     // measured values from touch upper left corner
-const int YTmax = RES_X; // measured values from touch lower right corner
-
-#elif defined(LCDtypeR)        // These are for the capacitive touch version
-// Problem with standard libs as only one SPI is used -> special CYD_xxx lib needed
-#define XPT2046_IRQ 36         // Unused interupt pin
-#define XPT2046_MOSI HSPI_MOSI // 13 // diffrent from CYD source = 32
-#define XPT2046_MISO HSPI_MISO // 12 // diffrent from CYD source = 39
-#define XPT2046_SCLK HSPI_SCK  // 14 // diffrent from CYD source = 25
-#define XPT2046_CS 33          // Chip select for touch
-// Define touch areas on screen
-const int XTmin = 57;   // measured values from touch upper left corner
-const int XTmax = 3788; // measured values from touch lower right corner
-const int YTmin = 3911; // measured values from touch upper left corner
-const int YTmax = 299;  // measured values from touch lower right corner
-#endif
-
-// Onboard led
-#define CYD_LED_RED 4    // The all in one led defining the lower left corner
-#define CYD_LED_GREEN 16 // All in one led
-#define CYD_LED_BLUE 17  // All in one led
-#define LED_ON LOW
-#define LED_OFF HIGH
-
 byte backlightTarget  = 32; // Control of pwm dimmed backlight
 byte backlightCurrent = 1;  // Helper to control dimmed backlight
 
@@ -128,22 +66,65 @@ unsigned long lastTouchTime = 0;     // Last time touch was detected
 bool          touchReleased = false; // True if touch was released in the last frame
 bool          touchHeld     = false; // True if touch is currently held
 
-Adafruit_ST7789 cyd = Adafruit_ST7789(
-    CYD_CS, CYD_DC, CYD_RST); // When resistive touch below software spi is not usable !
+Display& cyd = hal::display();
 
 // ================================================
 // Bluetooth remote
 SonyBluetoothRemote sonyBluetoothRemote;
+ShotScheduler       shotScheduler(sonyBluetoothRemote);
+
+// ================================================
+// Lightning detection
+LightningDetector lightningDetector;
+
+// ================================================
+// Storm session log
+StormLog stormLog;
 
 // ================================================
 // Application data
 
 int           lightCurrentReading    = 20;
+bool          lightDetected          = false;
+int           photodiodeThreshold    = 200; // Photodiode rise above its baseline, in ADC counts
 float         triggerSensitivity     = 50.0f;
 bool          triggerEnabled         = false;
 bool          triggerManual          = false;
 int           triggerMinimumInterval = 1000; // Trigger at most once per second
 unsigned long triggerLastFired       = 0;
+unsigned long movieQuietPeriod       = 30000;  // Stop a movie after 30s without a trigger
+unsigned long movieMaxLength         = 600000; // and never record more than 10 minutes
+bool          timelapseEnabled       = false;  // Still+TL: a timelapse between lightning shots
+unsigned long timelapseInterval      = 30000;  // Between timelapse shots
+unsigned long cameraBusyTime         = 1000;   // Exposure and write-out of a shot
+volatile bool manualFireRequested    = false;  // The Fire button, handled by the sensing task
+volatile bool connectedStateChanged  = false;  // Set by the BLE callback, drawn by loop()
+bool          summaryShown           = false;  // The storm summary page is up
+
+// Boot timing, in microseconds since power-on
+unsigned long          bootSettingsDone = 0;
+volatile unsigned long bootSensingLive  = 0;
+unsigned long          bootDisplayDone  = 0;
+unsigned long          bootBleDone      = 0;
+
+// ================================================
+// Settings, kept in NVS across power cycles
+
+struct Settings
+{
+    uint8_t version;
+    uint8_t manual;
+    uint8_t armed;
+    uint8_t captureMode;
+    uint8_t timelapse;
+    float   sensitivity; // Only restored in manual mode; auto starts from the current reading
+    int32_t minimumInterval;
+};
+
+const uint8_t       SETTINGS_VERSION  = 2;
+const unsigned long SETTINGS_SAVE_MS  = 50; // An NVS write, with the odd page erase
+bool                settingsChanged   = false;
+unsigned long       settingsChangedAt = 0;
 
 // ================================================
 // User interface
@@ -169,16 +150,19 @@ void onSensitivityDown(Button& button);
 void onEnableDisable(Button& button);
 void onTestTrigger(Button& button);
 void onAutoManual(Button& button);
-void fireTrigger();
+void onStillMovie(Button& button);
+void fireTrigger(bool manual);
+unsigned long flashStallBudget();
 
 Button button_auto(20, 100, 100, 50, COL_OLIVE, "Auto", 2, onAutoManual);
 Button button_up(140, 100, 70, 50, COL_NAVY, "+", 3, onSensitivityUp, false);
 Button button_down(140, 170, 70, 50, COL_NAVY, "-", 3, onSensitivityDown, false);
+Button button_movie(20, 170, 100, 50, COL_DARKCYAN, "Still", 2, onStillMovie);
 Button button_pause(20, 240, 100, 50, COL_MAROON, "Paused", 2, onEnableDisable);
 Button button_fire(140, 240, 70, 50, COL_MAROON, "Fire", 2, onTestTrigger);
 
-std::vector<Button*> buttons = {&button_auto, &button_up, &button_down, &button_pause,
-                                &button_fire};
+std::vector<Button*> buttons = {&button_auto,  &button_up,    &button_down,
+                                &button_movie, &button_pause, &button_fire};
 
 void drawText(const char* text, int x, int y, int fontSize, uint16_t color)
 {
@@ -235,11 +219,12 @@ void drawConnectedState(bool isConnected)
                      isConnected ? COL_GREEN : COL_RED, true);
 }
 
-void drawCurrentReading()
+void drawCurrentReading(bool force = false)
 {
     static int lastReading            = -1;
     static int lastSensitivityReading = -1;
-    if (lightCurrentReading == lastReading && triggerSensitivity == lastSensitivityReading)
+    if (!force && lightCurrentReading == lastReading &&
+        triggerSensitivity == lastSensitivityReading)
         return; // Reduce flicker
     lastReading            = lightCurrentReading;
     lastSensitivityReading = triggerSensitivity;
@@ -256,15 +241,17 @@ void drawCurrentReading()
         bgColor = COL_RED;
     }
 
+    char text[8];
+    snprintf(text, sizeof(text), "%d", lightCurrentReading);
     cyd.fillRect(x, y, w, h, bgColor);
-    drawCenteredText(String(lightCurrentReading).c_str(), x, y, w, h, 5, color);
+    drawCenteredText(text, x, y, w, h, 5, color);
 }
 
-void drawSensitivity()
+void drawSensitivity(bool force = false)
 {
     static int lastReading = -1;
     int        newReading  = int(triggerSensitivity);
-    if (newReading == lastReading)
+    if (!force && newReading == lastReading)
         return; // Reduce flicker
     lastReading = newReading;
 
@@ -273,15 +260,130 @@ void drawSensitivity()
     int w = 75;
     int h = 50;
 
+    char text[8];
+    snprintf(text, sizeof(text), "%d", newReading);
     cyd.fillRect(x, y, w, h, COL_BLACK);
-    drawCenteredText(String(newReading).c_str(), x, y, w, h, 3, COL_GREEN);
+    drawCenteredText(text, x, y, w, h, 3, COL_GREEN);
+}
+
+void drawRecordingState(bool force = false)
+{
+    static int lastRecording = -1;
+    int        recording     = sonyBluetoothRemote.isRecording();
+    if (!force && recording == lastRecording)
+        return;
+    lastRecording = recording;
+
+    drawCenteredText(recording ? "REC" : "", 140, 84, 75, 12, 1, COL_RED, true);
 }
 
 void drawLabels() { drawCenteredText("Trigger:", 140, 20, 75, 10, 1, COL_LIGHTGREY); }
 
+void drawMainScreen()
+{
+    cyd.fillRect(0, 0, RES_X, RES_Y, COL_BLACK); // Clear the screen
+
+    drawButtons();
+    drawSensitivity(true);
+    drawLabels();
+    drawConnectedState(sonyBluetoothRemote.isConnected());
+    drawCurrentReading(true);
+    drawRecordingState(true);
+}
+
+// ================================================
+// Storm summary page, shown by tapping the connection state
+
+void formatDuration(char* text, size_t size, uint32_t ms)
+{
+    uint32_t minutes = ms / 60000;
+    snprintf(text, size, "%luh%02lum", (unsigned long)(minutes / 60), (unsigned long)(minutes % 60));
+}
+
+void drawSummaryLine(int line, const char* label, const char* value)
+{
+    char text[32];
+    snprintf(text, sizeof(text), "%-9s%9s", label, value); // Fixed width, so it overwrites
+    drawText(text, 12, 14 + line * 24, 2, COL_WHITE);
+}
+
+void drawSummary()
+{
+    StormSummary summary;
+    stormLog.summary(summary);
+
+    char     value[16];
+    uint32_t triggers = summary.detected + summary.manual;
+    snprintf(value, sizeof(value), "%u", unsigned(summary.session));
+    drawSummaryLine(0, "Session", value);
+    formatDuration(value, sizeof(value), summary.uptime);
+    drawSummaryLine(1, "Up", value);
+    snprintf(value, sizeof(value), "%lu", (unsigned long)triggers);
+    drawSummaryLine(2, "Triggers", value);
+    snprintf(value, sizeof(value), "%lu", (unsigned long)summary.detected);
+    drawSummaryLine(3, " detected", value);
+    snprintf(value, sizeof(value), "%lu", (unsigned long)summary.manual);
+    drawSummaryLine(4, " manual", value);
+    snprintf(value, sizeof(value), "%lu", (unsigned long)summary.noCamera);
+    drawSummaryLine(5, "No camera", value);
+
+    // Hundredths, as printf's float support can reach for the heap
+    uint32_t uptime    = std::max<uint32_t>(summary.uptime, 1);
+    uint32_t perMinute = uint32_t(uint64_t(triggers) * 6000000 / uptime);
+    snprintf(value, sizeof(value), "%lu.%02lu", (unsigned long)(perMinute / 100),
+             (unsigned long)(perMinute % 100));
+    drawSummaryLine(6, "Per min", value);
+    formatDuration(value, sizeof(value), summary.connectedTime);
+    drawSummaryLine(7, "Camera", value);
+    snprintf(value, sizeof(value), "%lu%%",
+             (unsigned long)(uint64_t(summary.connectedTime) * 100 / uptime));
+    drawSummaryLine(8, " of time", value);
+    snprintf(value, sizeof(value), "%lu", (unsigned long)summary.connections);
+    drawSummaryLine(9, " connects", value);
+    snprintf(value, sizeof(value), "%lu", (unsigned long)summary.written);
+    drawSummaryLine(10, "Logged", value);
+    if (summary.dropped)
+    {
+        snprintf(value, sizeof(value), "%lu", (unsigned long)summary.dropped);
+        drawSummaryLine(11, " dropped", value);
+    }
+}
+
+void showSummary(bool show)
+{
+    summaryShown = show;
+    if (!show)
+    {
+        drawMainScreen();
+        return;
+    }
+    cyd.fillRect(0, 0, RES_X, RES_Y, COL_BLACK);
+    drawCenteredText("Tap to go back", 0, 300, 240, 12, 1, COL_LIGHTGREY);
+    drawSummary();
+}
+
+void updateSummary()
+{
+    static unsigned long lastDrawn = 0;
+    if (millis() - lastDrawn < 1000)
+        return;
+    lastDrawn = millis();
+    drawSummary();
+}
+
 void ui_processTouch(int x, int y)
 {
     // Serial.printf("Touch at %d, %d\n", x, y);
+    if (summaryShown)
+    {
+        showSummary(false);
+        return;
+    }
+    if (y >= 290)
+    {
+        showSummary(true); // The connection state line
+        return;
+    }
     for (auto button : buttons)
     {
         if (!button->visible)
@@ -315,22 +417,106 @@ void ui_updateEffects()
 
 void drawLastTouch() { cyd.fillRect(touchX - 5, touchY - 5, 10, 10, COL_RED); }
 
+// Brings the buttons' labels and colours in line with the current settings.
+void updateButtonStates()
+{
+    bool movie = sonyBluetoothRemote.getCaptureMode() == CaptureMode::Movie;
+
+    button_auto.label   = triggerManual ? "Manual" : "Auto";
+    button_auto.fill    = triggerManual ? COL_MAROON : COL_OLIVE;
+    button_up.visible   = triggerManual;
+    button_down.visible = triggerManual;
+    button_movie.label  = movie ? "Movie" : timelapseEnabled ? "Still+TL" : "Still";
+    button_movie.fill   = movie ? COL_PURPLE : timelapseEnabled ? COL_NAVY : COL_DARKCYAN;
+    button_pause.label  = triggerEnabled ? "Running" : "Paused";
+    button_pause.fill   = triggerEnabled ? COL_DARKGREEN : COL_MAROON;
+}
+
+// ================================================
+// Settings
+
+void markSettingsChanged()
+{
+    settingsChanged   = true;
+    settingsChangedAt = millis();
+}
+
+void loadSettings()
+{
+    Settings settings = {};
+    if (!hal::loadSettings(&settings, sizeof(settings)) || settings.version != SETTINGS_VERSION)
+        return; // First boot, keep the defaults
+
+    triggerManual          = settings.manual;
+    triggerEnabled         = settings.armed;
+    triggerMinimumInterval = settings.minimumInterval;
+    if (triggerManual)
+        triggerSensitivity = constrain(settings.sensitivity, 10, 110);
+    if (settings.captureMode <= uint8_t(CaptureMode::Movie))
+        sonyBluetoothRemote.setCaptureMode(CaptureMode(settings.captureMode));
+    timelapseEnabled = settings.timelapse;
+}
+
+void saveSettings()
+{
+    settingsChanged = false;
+
+    Settings settings = {}; // Padding included, it all goes to NVS
+    settings.version         = SETTINGS_VERSION;
+    settings.manual          = triggerManual;
+    settings.armed           = triggerEnabled;
+    settings.captureMode     = uint8_t(sonyBluetoothRemote.getCaptureMode());
+    settings.timelapse       = timelapseEnabled;
+    settings.sensitivity     = triggerSensitivity;
+    settings.minimumInterval = triggerMinimumInterval;
+
+    allocGuard::Pause inNvs; // NVS manages its own page cache
+    hal::saveSettings(&settings, sizeof(settings));
+}
+
+void updateSaveSettings()
+{
+    // Let a burst of taps settle rather than writing flash for each one, and
+    // like the storm log, wait for a moment the stall can't cost a flash.
+    if (!settingsChanged || millis() - settingsChangedAt < 2000 ||
+        flashStallBudget() < SETTINGS_SAVE_MS)
+        return;
+    saveSettings();
+}
+
 // ================================================
 // UI event handlers
 
 void onAutoManual(Button& button)
 {
-    triggerManual       = !triggerManual;
-    button.label        = triggerManual ? "Manual" : "Auto";
-    button.fill         = triggerManual ? COL_MAROON : COL_OLIVE;
-    button_up.visible   = triggerManual;
-    button_down.visible = triggerManual;
+    triggerManual = !triggerManual;
+    updateButtonStates();
     if (!triggerManual)
     {
         clearButton(button_up);
         clearButton(button_down);
     }
     drawButtons();
+    markSettingsChanged();
+}
+
+// The timelapse only runs while the trigger does
+void updateTimelapse()
+{
+    shotScheduler.setTimelapseInterval(timelapseEnabled && triggerEnabled ? timelapseInterval : 0);
+}
+
+// Still, then Still+TL, then Movie
+void onStillMovie(Button& button)
+{
+    bool still       = sonyBluetoothRemote.getCaptureMode() == CaptureMode::Still;
+    bool movie       = still && timelapseEnabled;
+    timelapseEnabled = still && !timelapseEnabled;
+    sonyBluetoothRemote.setCaptureMode(movie ? CaptureMode::Movie : CaptureMode::Still);
+    updateTimelapse();
+    updateButtonStates();
+    drawButtons();
+    markSettingsChanged();
 }
 
 void onSensitivityUp(Button& button)
@@ -338,6 +524,7 @@ void onSensitivityUp(Button& button)
     triggerSensitivity += 10;
     triggerSensitivity = constrain(triggerSensitivity, 10, 110);
     drawSensitivity();
+    markSettingsChanged();
 }
 
 void onSensitivityDown(Button& button)
@@ -345,79 +532,37 @@ void onSensitivityDown(Button& button)
     triggerSensitivity -= 10;
     triggerSensitivity = constrain(triggerSensitivity, 10, 110);
     drawSensitivity();
+    markSettingsChanged();
 }
 
 void onEnableDisable(Button& button)
 {
     triggerEnabled = !triggerEnabled;
-    button.label   = triggerEnabled ? "Running" : "Paused";
-    button.fill    = triggerEnabled ? COL_DARKGREEN : COL_MAROON;
+    updateTimelapse();
+    updateButtonStates();
     drawButtons();
+    // Once running, a save waits for a trigger, which in a quiet spell might not
+    // come before the power goes. Right after the tap, a stall costs nothing.
+    if (triggerEnabled)
+        saveSettings();
+    else
+        markSettingsChanged();
 }
 
-void onTestTrigger(Button& button) { fireTrigger(); }
+void onTestTrigger(Button& button) { manualFireRequested = true; }
 
 // ================================================
 // Touch handling
 
-#if defined(LCDtypeC)
-BBCapTouch  touch;
-TOUCHINFO   ti;
-const char* szNames[] = {"Unknown", "FT6x36", "GT911", "CST820"};
-#elif defined(LCDtypeR)
-XPT2046_Touchscreen touchHW(XPT2046_CS);
-#endif
-
-void touchInit()
-{
-#if defined(LCDtypeC)
-    touch.init(CST820_SDA, CST820_SCL, CST820_RST,
-               CST820_IRQ); // sda, scl, rst, irq
-    int iType = touch.sensorType();
-    Serial.printf("Sensor type = %s\n", szNames[iType]);
-#elif defined LCDtypeR
-    touchHW.begin();
-    touchHW.setRotation(3); // Light sensor is at top right
-#endif
-}
-
-bool getTouch(int& x, int& y)
-{
-#if defined(LCDtypeR) // Resistive
-    if (!touchHW.touched())
-        return false;
-
-    TS_Point p = touchHW.getPoint();
-    x          = p.x;
-    y          = p.y;
-    return true;
-#elif defined(LCDtypeC) // Capacitive
-    if (!touch.getSamples(&ti))
-        return false;
-    x = ti.y[0];
-    y = ti.x[0];
-    return true;
-#else
-    return false;
-#endif
-}
-
 void updateTouch()
 {
-    int xRaw = 0;
-    int yRaw = 0;
-    if (!getTouch(xRaw, yRaw))
+    if (!hal::readTouch(touchX, touchY))
     {
         touchReleased = touchHeld;
         touchHeld     = false;
         return;
     }
 
-    touchX = map(xRaw, XTmin, XTmax, 0, RES_X);
-    touchY = map(yRaw, YTmin, YTmax, 0, RES_Y);
-    touchX = constrain(touchX, 0, RES_X);
-    touchY = constrain(touchY, 0, RES_Y);
-
     lastTouchTime = millis();
     touchHeld     = true;
 }
@@ -427,11 +572,10 @@ void updateTouch()
 
 void updateLightReading()
 {
-    // This could likely be sped up substantially if we use the raw ESP32 functions.
-    lightCurrentReading = analogRead(CYD_LDR);
-    lightCurrentReading = map(lightCurrentReading, 0, 2000, 100, 0);
-    if (lightCurrentReading < 0)
-        lightCurrentReading = 0;
+    hal::LightSample sample;
+    hal::readLightSensors(sample);
+    lightDetected       = lightningDetector.update(sample);
+    lightCurrentReading = lightningDetector.ldrReading();
 }
 
 void updateBacklight()
@@ -440,33 +584,141 @@ void updateBacklight()
     {
         // TODO: Can add slow fade in/out here
         backlightCurrent = backlightTarget;
-        analogWrite(CYD_BL, backlightCurrent);
+        hal::setBacklight(backlightCurrent);
     }
 }
 
-void fireTrigger()
+uint8_t stormFlags()
 {
-    sonyBluetoothRemote.trigger();
+    uint8_t flags = 0;
+    if (sonyBluetoothRemote.getCaptureMode() == CaptureMode::Movie)
+        flags |= STORM_FLAG_MOVIE;
+    if (triggerEnabled)
+        flags |= STORM_FLAG_RUNNING;
+    if (sonyBluetoothRemote.isConnected())
+        flags |= STORM_FLAG_CONNECTED;
+    return flags;
+}
 
-    Serial.print("Trigger fired at ");
-    Serial.print(lightCurrentReading);
-    Serial.print("  Millis:");
-    Serial.println(millis());
+void fireTrigger(bool manual)
+{
+    shotScheduler.lightning();
+
+    LOG_INFO(TriggerFired, int32_t(lightCurrentReading));
     triggerLastFired = millis();
+
+    uint8_t flags = stormFlags();
+    if (!manual && lightningDetector.photodiodeDetecting())
+        flags |= STORM_FLAG_PHOTODIODE;
+    stormLog.record(manual ? StormEventType::Manual : StormEventType::Detected,
+                    lightCurrentReading, int(triggerSensitivity), flags);
 }
 
 bool updateCheckTrigger()
 {
-    if (triggerEnabled && lightCurrentReading > triggerSensitivity &&
+    if (triggerEnabled && lightDetected &&
         (millis() - triggerLastFired) > triggerMinimumInterval)
     {
-        fireTrigger();
+        fireTrigger(false);
         triggerLastFired = millis();
         return true;
     }
     return false;
 }
 
+// In Auto mode, start the sensitivity from the actual light level rather than
+// drifting there from the default over several seconds.
+void seedAutoSensitivity()
+{
+    if (triggerManual)
+        return;
+    updateLightReading();
+    triggerSensitivity = constrain(lightCurrentReading + 10.0f, 10, 110);
+}
+
+// Runs over and over in its own task, from early in setup(). See
+// hal::startSensingTask().
+void sensingPass()
+{
+    if (!bootSensingLive)
+    {
+        bootSensingLive = micros();
+        allocGuard::watchThisTask();
+    }
+
+    if (manualFireRequested)
+    {
+        manualFireRequested = false;
+        fireTrigger(true);
+    }
+    shotScheduler.update();
+
+    // A tight loop to make sure we spend the majority of our time
+    // checking the light sensors.
+    // TODO: Ideally we'd just set up an interrupt to trigger when the value
+    // goes above a certain threshold.
+    lightningDetector.setLdrThreshold(triggerSensitivity);
+    for (int i = 0; i < 1000; i++)
+    {
+        updateLightReading();
+        if (updateCheckTrigger())
+            break;
+    }
+}
+
+// Once armed, loop() must run without touching the heap. Only enforced in
+// ALLOC_GUARD builds, see allocGuard.h.
+bool isArmed()
+{
+#ifdef TEST_UI_ONLY
+    return triggerEnabled;
+#else
+    return triggerEnabled && sonyBluetoothRemote.isConnected();
+#endif
+}
+
+void checkNoAllocations(bool armed, uint32_t allocationsBefore)
+{
+    uint32_t allocations = allocGuard::count() - allocationsBefore;
+    if (armed && allocations > 0)
+    {
+        Serial.printf("ALLOC_GUARD: %u heap allocations in an armed loop()\n",
+                      unsigned(allocations));
+        Serial.flush();
+        abort();
+    }
+}
+
+// How long a flash write (the storm log, or NVS saving the settings) may stall
+// the flash, and with it sensing, right now. As long as it likes while a
+// trigger can't fire anyway: when not armed, or in the minimum interval after
+// a trigger. Otherwise just long enough for a page write, which is well inside
+// the LDR's response time.
+unsigned long flashStallBudget()
+{
+    unsigned long sinceFired = millis() - triggerLastFired;
+    if (!isArmed())
+        return ULONG_MAX;
+    if (sinceFired < (unsigned long)triggerMinimumInterval)
+        return triggerMinimumInterval - sinceFired;
+    return 2;
+}
+
+void flushStormLog() { stormLog.flush(flashStallBudget()); }
+
+// Called from the BLE stack's task, so the drawing is left to loop()
+void onConnectedStateChange(bool isConnected)
+{
+    static bool wasConnected = false;
+    if (isConnected != wasConnected)
+    {
+        stormLog.record(isConnected ? StormEventType::Connected : StormEventType::Disconnected,
+                        lightCurrentReading, int(triggerSensitivity), stormFlags());
+        wasConnected = isConnected;
+    }
+    connectedStateChanged = true;
+}
+
 void updateAutoSensitivity()
 {
     // Honestly, we could probably just say triggerSensitivity = lightCurrentReading + 10
@@ -487,7 +739,8 @@ void updateAutoSensitivity()
                 triggerSensitivity -= tDiff * 10.0f;
             triggerSensitivity = constrain(triggerSensitivity, 10, 110);
         }
-        drawSensitivity();
+        if (!summaryShown)
+            drawSensitivity();
     }
     lastAutoUpdate = now;
 }
@@ -495,76 +748,97 @@ void updateAutoSensitivity()
 // ================================================
 // Main setup and loop
 
+void reportBootTimes()
+{
+    LOG_INFO(Boot, triggerEnabled ? "running" : "paused", int32_t(bootSettingsDone / 1000),
+             int32_t(bootSensingLive / 1000), int32_t(bootDisplayDone / 1000),
+             int32_t(bootBleDone / 1000));
+}
+
 void setup()
 {
     // Initialize debug output and wifi and preset mqtt
     Serial.begin(115200);
-    pinMode(CYD_LED_BLUE, OUTPUT);
-    pinMode(CYD_LED_GREEN, OUTPUT);
-    pinMode(CYD_LED_RED, OUTPUT);
-    digitalWrite(CYD_LED_RED, LED_OFF);
-    digitalWrite(CYD_LED_GREEN, LED_OFF);
-    digitalWrite(CYD_LED_BLUE, LED_OFF);
-
-    analogSetPinAttenuation(CYD_LDR, ADC_0db); // Needs maximum sensitivity.
-
-    SPI.begin(HSPI_SCK, HSPI_MISO, HSPI_MOSI);
+    hal::init();
+    asyncLog::startDrainTask();
+
+    // Restore the settings and get sensing going first, so the trigger is live
+    // well before the display and BLE have finished starting up.
+    loadSettings();
+    bootSettingsDone = micros();
+    lightningDetector.setPhotodiodeEnabled(hal::hasPhotodiode());
+    lightningDetector.setPhotodiodeThreshold(photodiodeThreshold);
+    seedAutoSensitivity();
+    shotScheduler.setCameraBusyTime(cameraBusyTime);
+    updateTimelapse();
+    hal::startSensingTask(sensingPass);
+
+    stormLog.begin();
+    stormLog.record(StormEventType::Boot, lightCurrentReading, int(triggerSensitivity),
+                    stormFlags());
+    hal::startBackgroundTask(flushStormLog);
 
     // Start screen
-    pinMode(CYD_BL, OUTPUT);
-    analogWrite(CYD_BL, backlightTarget);
-
-    cyd.init(RES_X, RES_Y);
-    cyd.invertDisplay(false);
-    cyd.setRotation(2); // Light sensor is at top right
+    hal::setBacklight(backlightTarget);
+    hal::initDisplay();
 
-    cyd.fillRect(0, 0, RES_X, RES_Y, COL_BLACK); // Clear the screen
-
-    cyd.fillRect(0, 0, RES_X, RES_Y, COL_BLACK); // Clear the screen
+    updateButtonStates();
+    drawMainScreen();
 
-    drawButtons();
-    drawSensitivity();
-    drawLabels();
-    drawConnectedState(false);
-
-    touchInit();
+    hal::initTouch();
+    bootDisplayDone = micros();
 
 #ifndef TEST_UI_ONLY
-    Serial.println("Connecting to camera...");
+    LOG_INFO(Connecting);
     sonyBluetoothRemote.init("AB Lightning Trigger");
     sonyBluetoothRemote.pairWith("ILCE-7CM2");
-    sonyBluetoothRemote.setConnectedStateChangeCallback(drawConnectedState);
+    sonyBluetoothRemote.setConnectedStateChangeCallback(onConnectedStateChange);
+    sonyBluetoothRemote.setMovieQuietPeriod(movieQuietPeriod);
+    sonyBluetoothRemote.setMovieMaxLength(movieMaxLength);
 #endif
+    bootBleDone = micros();
+    reportBootTimes();
+
+    allocGuard::watchThisTask();
 }
 
 void loop()
 {
+    bool     armed             = isArmed();
+    uint32_t allocationsBefore = allocGuard::count();
+
 #ifndef TEST_UI_ONLY
     sonyBluetoothRemote.update();
 #endif
 
-    // A tight loop to make sure we spend the majority of our time
-    // checking the light sensor.
-    // TODO: Ideally we'd just set up an interrupt to trigger when the value
-    // goes above a certain threshold.
-    for (int i = 0; i < 1000; i++)
+    // The light sensors are read by the sensing task, see sensingPass().
+    if (summaryShown)
+        updateSummary();
+    else
     {
-        updateLightReading();
-        if (updateCheckTrigger())
-            break;
+        drawCurrentReading();
+        drawRecordingState();
+        if (connectedStateChanged)
+        {
+            connectedStateChanged = false;
+            drawConnectedState(sonyBluetoothRemote.isConnected());
+        }
     }
 
-    drawCurrentReading();
-
     updateTouch();
     // drawLastTouch(); // For debugging and calibrating touch.
 
     if (touchReleased)
         ui_processTouch(touchX, touchY);
 
-    ui_updateEffects();
+    if (!summaryShown)
+        ui_updateEffects();
 
     updateBacklight();
 
     updateAutoSensitivity();
+
+    updateSaveSettings();
+
+    checkNoAllocations(armed && isArmed(), allocationsBefore);
 }
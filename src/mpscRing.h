@@ -0,0 +1,69 @@
+#pragma once
+// A bounded lock-free queue for passing small records from any task to a
+// single consumer, after Dmitry Vyukov's. push() never blocks: when the ring is
+// full it just returns false. Only one task may pop().
+//
+// Each slot's sequence says whose turn it is. For the item at position pos,
+// and lap = pos & ~MASK, the slot is:
+//   sequence == lap           free for the producer writing pos
+//   sequence == lap + 1       written, ready for the consumer
+//   sequence == lap + SIZE    popped, free for the next lap round
+// which starts out right with every sequence zero, so a ring needs no setup.
+
+#include <atomic>
+#include <cstdint>
+
+template <typename T, uint32_t SIZE> class MpscRing
+{
+    static_assert((SIZE & (SIZE - 1)) == 0, "SIZE must be a power of two");
+
+  public:
+    bool push(const T& item)
+    {
+        uint32_t pos = _head.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Slot&   slot = _slots[pos & MASK];
+            int32_t turn = int32_t(slot.sequence.load(std::memory_order_acquire) - (pos & ~MASK));
+            if (turn == 0)
+            {
+                if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (turn < 0)
+                return false; // Still holding an item from the last lap round: full
+            else
+                pos = _head.load(std::memory_order_relaxed); // Another producer got there first
+        }
+
+        Slot& slot = _slots[pos & MASK];
+        slot.item  = item;
+        slot.sequence.store((pos & ~MASK) + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item)
+    {
+        Slot&    slot = _slots[_tail & MASK];
+        uint32_t lap  = _tail & ~MASK;
+        if (slot.sequence.load(std::memory_order_acquire) != lap + 1)
+            return false;
+        item = slot.item;
+        slot.sequence.store(lap + SIZE, std::memory_order_release);
+        _tail++;
+        return true;
+    }
+
+  private:
+    static const uint32_t MASK = SIZE - 1;
+
+    struct Slot
+    {
+        std::atomic<uint32_t> sequence{0};
+        T                     item;
+    };
+
+    Slot                  _slots[SIZE];
+    std::atomic<uint32_t> _head{0}; // Next position to push
+    uint32_t              _tail = 0; // Next position to pop, only touched by the consumer
+};
@@ -0,0 +1,49 @@
+#include "shotScheduler.h"
+
+#include <Arduino.h>
+
+void ShotScheduler::lightning()
+{
+    if (_shotWasTimelapse && _remote.isShooting())
+        _lightningCutIn++;
+
+    _remote.trigger();
+    _lastShot         = millis();
+    _lastLightning    = _lastShot;
+    _shotWasTimelapse = false;
+}
+
+void ShotScheduler::update()
+{
+    _remote.updateCommands();
+
+    unsigned long now = millis();
+    if (_interval != _requestedInterval)
+    {
+        // Turned on or changed: the first shot goes straight away
+        _interval      = _requestedInterval;
+        _nextTimelapse = now;
+        _holding       = false;
+    }
+    if (_interval == 0 || !_remote.isConnected() ||
+        _remote.getCaptureMode() != CaptureMode::Still || long(now - _nextTimelapse) < 0)
+        return;
+
+    if (_remote.isShooting() || now - _lastShot < _cameraBusyTime ||
+        now - _lastLightning < LIGHTNING_HOLDOFF)
+    {
+        if (!_holding)
+            _timelapseHeld++;
+        _holding = true;
+        return;
+    }
+
+    _remote.takePhoto();
+    _lastShot         = now;
+    _shotWasTimelapse = true;
+    _holding          = false;
+    _nextTimelapse    = now + _interval;
+    _timelapseShots++;
+    if (_timelapseShotCallback)
+        _timelapseShotCallback();
+}
@@ -0,0 +1,60 @@
+#pragma once
+// Shares the camera between lightning and an interval timelapse.
+//
+// Lightning always comes first: lightning() presses the shutter on the spot,
+// cutting short a timelapse photo still in progress. Timelapse shots only go
+// out when the camera is free, meaning no photo in progress, the camera's own
+// busy time since the last shot passed, and a few seconds clear of the last
+// lightning shot, since strokes come in bursts. A timelapse shot held back
+// goes as soon as the camera frees up, and the next interval counts from when
+// it was actually taken. In Movie mode the timelapse pauses.
+//
+// lightning() and update() send camera commands, so they must be called from
+// the same task as each other and as the remote's other commands.
+
+#include <cstdint>
+
+#include "sonyBluetoothRemote.h"
+
+class ShotScheduler
+{
+  public:
+    explicit ShotScheduler(SonyBluetoothRemote& remote) : _remote(remote) {}
+
+    // 0 turns the timelapse off. Can be called from any task.
+    void setTimelapseInterval(unsigned long ms) { _requestedInterval = ms; }
+    // From the shutter press until the camera will take another photo:
+    // exposure and write-out
+    void setCameraBusyTime(unsigned long ms) { _cameraBusyTime = ms; }
+
+    void lightning();
+    void update(); // Call often
+
+    // Called just after each timelapse shutter press, so the simulator can
+    // tell timelapse photos from lightning ones.
+    void setTimelapseShotCallback(void (*callback)()) { _timelapseShotCallback = callback; }
+
+    uint32_t timelapseShots() const { return _timelapseShots; }
+    uint32_t timelapseHeld() const { return _timelapseHeld; }   // Due, but waited for the camera
+    uint32_t lightningCutIn() const { return _lightningCutIn; } // Cut a timelapse photo short
+
+  private:
+    // Keeps the timelapse off the camera for the strokes that follow a strike
+    static const unsigned long LIGHTNING_HOLDOFF = 3000;
+
+    SonyBluetoothRemote& _remote;
+    void (*_timelapseShotCallback)() = nullptr;
+
+    volatile unsigned long _requestedInterval = 0;
+    unsigned long          _interval          = 0; // As scheduled
+    unsigned long          _cameraBusyTime    = 500;
+    unsigned long          _nextTimelapse     = 0;
+    unsigned long          _lastShot          = 0;
+    unsigned long          _lastLightning     = 0;
+    bool                   _shotWasTimelapse  = false;
+    bool                   _holding           = false;
+
+    uint32_t _timelapseShots = 0;
+    uint32_t _timelapseHeld  = 0;
+    uint32_t _lightningCutIn = 0;
+};
@@ -1,5 +1,9 @@
 #include "sonyBluetoothRemote.h"
 #include <Arduino.h>
+#include <cstring>
+
+#include "allocGuard.h"
+#include "asyncLog.h"
 
 namespace
 {
@@ -7,6 +11,24 @@ uint8_t PRESS_TO_FOCUS[]   = {0x01, 0x07};
 uint8_t TAKE_PICTURE[]     = {0x01, 0x09};
 uint8_t SHUTTER_RELEASED[] = {0x01, 0x06};
 uint8_t HOLD_FOCUS[]       = {0x01, 0x08};
+uint8_t RECORD_PRESSED[]   = {0x01, 0x0F}; // Toggles movie recording
+uint8_t RECORD_RELEASED[]  = {0x01, 0x0E};
+
+// Notifications: 0x02, what changed, its new state. Recording reports 0x20 when
+// started and 0x00 when stopped (Greg Leeds' Sony FF02 table in freemote).
+const uint8_t       NOTIFY_RECORDING = 0xD5;
+const uint8_t       NOTIFY_STARTED   = 0x20;
+const unsigned long RECORD_REPORT_MS = 3000; // Give up waiting for the camera to report a press
+
+// The BLE library calls back a plain function, which passes the report on
+SonyBluetoothRemote* notifyRemote = nullptr;
+
+void notifyCallback(BLERemoteCharacteristic* characteristic, uint8_t* data, size_t length,
+                    bool isNotify)
+{
+    if (notifyRemote)
+        notifyRemote->onNotify(data, length);
+}
 } // namespace
 
 // ================================================
@@ -15,24 +37,27 @@ uint8_t HOLD_FOCUS[]       = {0x01, 0x08};
 
 // The BLEAdvertisedDeviceCallbacks class is used during the initial scanning
 // to find the camera to connect to.
+// The library passes the device by value; we only get here while scanning,
+// never once connected and armed.
 void SonyBluetoothRemote::onResult(BLEAdvertisedDevice advertisedDevice)
 {
-    if (advertisedDevice.getName().empty())
+    const std::string name = advertisedDevice.getName(); // getName() copies, so only once
+    if (name.empty())
         return;
 
-    Serial.print("BLE: something found: ");
-    Serial.println(advertisedDevice.getName().c_str());
+    LOG_DEBUG(BleFound, name.c_str());
 
     // Check if the name of the advertiser matches
-    if (advertisedDevice.getName() == _targetCameraName)
+    if (name == _targetCameraName)
     {
         // Scan can be stopped, we found what we are looking for
         advertisedDevice.getScan()->stop();
 
         // Address of advertiser is the one we need
-        _pCameraAddress.reset(new BLEAddress(advertisedDevice.getAddress()));
+        memcpy(_cameraAddress, *advertisedDevice.getAddress().getNative(), sizeof(_cameraAddress));
+        _cameraAddressKnown = true;
 
-        Serial.println("Camera found. Connecting!");
+        LOG_INFO(BleCameraFound);
 
         auto data = advertisedDevice.getPayload();
         for (size_t i = 1; i < advertisedDevice.getPayloadLength(); i++)
@@ -41,14 +66,13 @@ void SonyBluetoothRemote::onResult(BLEAdvertisedDevice advertisedDevice)
             {
                 if ((data[i] & 0x40) == 0x40 && (data[i] & 0x02) == 0x02)
                 {
-                    Serial.println("Camera is ready to pair");
+                    LOG_INFO(BleReadyToPair);
                     _doPairing = true;
                 }
                 else
                 {
                     _doConnect = true;
-                    Serial.println("Camera is not ready to pair, but "
-                                    "trying to connect");
+                    LOG_INFO(BleNotReadyToPair);
                 }
             }
         }
@@ -58,38 +82,41 @@ void SonyBluetoothRemote::onResult(BLEAdvertisedDevice advertisedDevice)
 // BLEClientCallbacks
 void SonyBluetoothRemote::onConnect(BLEClient* pclient) 
 { 
-    Serial.println("Connected"); 
+    LOG_INFO(BleConnected);
 }
 
 
 void SonyBluetoothRemote::onDisconnect(BLEClient* pclient)
 {
+    _recording     = false; // The camera stops a clip when the remote goes away
+    _recordPending = false;
+    _clipIsOurs    = false;
+    _shotStep      = ShotStep::Idle;
     onConnectionStateChange(false);
-    Serial.println("Disconnected");
+    LOG_INFO(BleDisconnected);
 }
 
 // BLESecurityCallbacks
 // Accept any pair request from Camera
 uint32_t SonyBluetoothRemote::onPassKeyRequest()
 {
-    Serial.println("PassKeyRequest");
+    LOG_INFO(BlePassKeyRequest);
     return 123456;
 }
 
 void SonyBluetoothRemote::onPassKeyNotify(uint32_t pass_key)
 {
-    Serial.print("The passkey Notify number:");
-    Serial.println(pass_key);
+    LOG_INFO(BlePassKeyNotify, int32_t(pass_key));
 }
 
 bool SonyBluetoothRemote::onSecurityRequest()
 {
-    Serial.println("SecurityRequest");
+    LOG_INFO(BleSecurityRequest);
     return true;
 }
 
 
-void SonyBluetoothRemote::setConnectedStateChangeCallback(std::function<void(bool)> callback)
+void SonyBluetoothRemote::setConnectedStateChangeCallback(void (*callback)(bool))
 {
     _connectedStateChangeCallback = callback;
 }
@@ -97,11 +124,7 @@ void SonyBluetoothRemote::setConnectedStateChangeCallback(std::function<void(boo
 
 void SonyBluetoothRemote::onAuthenticationComplete(esp_ble_auth_cmpl_t cmpl)
 {
-    Serial.println("Authentication Complete");
-    if (cmpl.success)
-        Serial.println("Pairing success");
-    else
-        Serial.println("Pairing failed");
+    LOG_INFO(BleAuthComplete, cmpl.success ? "success" : "failed");
 }
 
 void SonyBluetoothRemote::init(std::string thisDeviceName)
@@ -121,10 +144,13 @@ bool SonyBluetoothRemote::connectToServer()
         _pClient->setClientCallbacks(this);
     }
 
+    if (!_cameraAddressKnown)
+        return false;
+
     // Connect to the remove BLE Server.
-    if (_pClient->connect(*_pCameraAddress))
+    if (_pClient->connect(BLEAddress(_cameraAddress)))
     {
-        Serial.println(" - Connected to server");
+        LOG_INFO(BleServerConnected);
         _doPairing = false;
         _doConnect = false;
 
@@ -132,7 +158,7 @@ bool SonyBluetoothRemote::connectToServer()
             _pClient->getService("8000FF00-FF00-FFFF-FFFF-FFFFFFFFFFFF");
         if (!pRemoteService)
         {
-            Serial.print("Failed to find our service UUID");
+            LOG_ERROR(BleNoService);
             return false;
         }
 
@@ -141,17 +167,20 @@ bool SonyBluetoothRemote::connectToServer()
 
         if (!_remoteCommand)
         {
-            Serial.println("Failed to find our characteristic command");
+            LOG_ERROR(BleNoCommand);
             return false;
         }
 
         if (!_remoteNotify)
         {
-            Serial.println("Failed to find our characteristic notify");
+            LOG_ERROR(BleNoNotify);
             return false;
         }
 
-        Serial.println("Camera BLE service and characteristic found");
+        notifyRemote = this;
+        _remoteNotify->registerForNotify(notifyCallback);
+
+        LOG_INFO(BleServiceFound);
 
         onConnectionStateChange(true);
 
@@ -159,7 +188,7 @@ bool SonyBluetoothRemote::connectToServer()
     }
     else
     {
-        Serial.println(" - fail to BLE connect");
+        LOG_WARN(BleConnectFailed);
         return false;
     }
 }
@@ -169,9 +198,9 @@ void SonyBluetoothRemote::pairOrConnect()
     BLEScan* pBLEScan = BLEDevice::getScan();
     pBLEScan->setAdvertisedDeviceCallbacks(this);
     pBLEScan->setActiveScan(true);
-    Serial.println("BLE: Looking for camera");
+    LOG_DEBUG(BleScanStart);
     pBLEScan->start(5);
-    Serial.println("BLE: end of searching");
+    LOG_DEBUG(BleScanEnd);
 }
 
 void SonyBluetoothRemote::trigger()
@@ -179,14 +208,108 @@ void SonyBluetoothRemote::trigger()
     if (!_connected)
         return;
 
+    if (_captureMode == CaptureMode::Movie)
+    {
+        _lastMovieTrigger = millis();
+        setRecording(true);
+        return;
+    }
+
+    takePhoto();
+}
+
+// Presses the shutter straight away, even in the middle of the last photo.
+// The camera only takes a photo on a new full press, so the rest of the last
+// one's release goes first, then the whole focus and shutter press.
+void SonyBluetoothRemote::takePhoto()
+{
+    if (!_connected)
+        return;
+
+    allocGuard::Pause inBleStack;
+    if (_shotStep == ShotStep::ShutterPressed)
+        _remoteCommand->writeValue(SHUTTER_RELEASED, 2, true);
+    if (_shotStep != ShotStep::Idle)
+        _remoteCommand->writeValue(HOLD_FOCUS, 2, true);
     _remoteCommand->writeValue(PRESS_TO_FOCUS, 2, true);
     _remoteCommand->writeValue(TAKE_PICTURE, 2, true);
-    delay(100);
-    _remoteCommand->writeValue(SHUTTER_RELEASED, 2, true);
-    delay(100);
-    _remoteCommand->writeValue(HOLD_FOCUS, 2, true);
+    _shotStep   = ShotStep::ShutterPressed;
+    _shotStepAt = millis();
+
+    LOG_INFO(BleTookPhoto);
+}
+
+void SonyBluetoothRemote::setCaptureMode(CaptureMode mode)
+{
+    // A clip still recording is stopped by the next updateCommands(), so that
+    // commands are only ever sent from one task.
+    _captureMode = mode;
+}
+
+void SonyBluetoothRemote::setRecording(bool on)
+{
+    if (_recordPending || _recording == on)
+        return;
+
+    allocGuard::Pause inBleStack;
+    _recordReported = false;
+    _remoteCommand->writeValue(RECORD_PRESSED, 2, true);
+    _remoteCommand->writeValue(RECORD_RELEASED, 2, true);
+    _recordPending   = true;
+    _recordPressedAt = millis();
+    _clipIsOurs      = on;
+    if (on)
+    {
+        _recordingStarted = _recordPressedAt;
+        LOG_INFO(BleRecordingStart);
+    }
+    else
+        LOG_INFO(BleRecordingStop);
+}
+
+void SonyBluetoothRemote::onNotify(const uint8_t* data, size_t length)
+{
+    if (length < 3 || data[0] != 0x02 || data[1] != NOTIFY_RECORDING)
+        return;
+    _recording      = data[2] == NOTIFY_STARTED; // Anything else, stopped
+    _recordReported = true;
+    LOG_INFO(BleCameraRecording, _recording ? "started" : "stopped");
+}
+
+void SonyBluetoothRemote::updateCommands()
+{
+    if (!_connected)
+        return;
+
+    unsigned long now = millis();
+    if (_shotStep != ShotStep::Idle && now - _shotStepAt >= 100)
+    {
+        allocGuard::Pause inBleStack;
+        if (_shotStep == ShotStep::ShutterPressed)
+        {
+            _remoteCommand->writeValue(SHUTTER_RELEASED, 2, true);
+            _shotStep = ShotStep::ShutterReleased;
+        }
+        else
+        {
+            _remoteCommand->writeValue(HOLD_FOCUS, 2, true);
+            _shotStep = ShotStep::Idle;
+        }
+        _shotStepAt = now;
+    }
+
+    // A press the camera never reported is taken not to have worked
+    if (_recordPending && (_recordReported || now - _recordPressedAt > RECORD_REPORT_MS))
+        _recordPending = false;
+    if (_recordPending)
+        return;
+    if (!_recording)
+        _clipIsOurs = false; // Ended, maybe by the camera itself; a new trigger starts another
 
-    Serial.println("BLE: took photo");
+    if (_recording && _clipIsOurs &&
+        (_captureMode != CaptureMode::Movie || now - _lastMovieTrigger > _movieQuietPeriod ||
+         now - _recordingStarted > _movieMaxLength))
+        setRecording(false);
 }
 
 void SonyBluetoothRemote::update()
@@ -11,9 +11,19 @@
 // I'm only using a tiny subset of the functionality of the freemote code here.
 
 #include <BLEDevice.h>
-#include <String>
-#include <functional>
-#include <memory>
+#include <string>
+
+// Still: each trigger takes a photo.
+// Movie: a trigger starts a movie clip, or keeps the current one going. The
+// clip stops after a quiet period with no triggers, or at the maximum length.
+// Whether the camera is recording comes from its own reports, so a clip it
+// ends by itself (length limit, full card, its own button) is never mistaken
+// for one still running, and never restarted by a blind "stop".
+enum class CaptureMode
+{
+    Still,
+    Movie,
+};
 
 class SonyBluetoothRemote : public BLEAdvertisedDeviceCallbacks,
                             public BLEClientCallbacks,
@@ -21,10 +31,23 @@ class SonyBluetoothRemote : public BLEAdvertisedDeviceCallbacks,
 {
   public:
     void init(std::string thisDeviceName);
-    void pairWith(std::string targetCameraName) { targetCameraName = targetCameraName; }
+    void pairWith(std::string targetCameraName) { _targetCameraName = targetCameraName; }
+    // trigger(), takePhoto() and updateCommands() send the camera commands,
+    // and must be called from the same task. update() looks after the
+    // connection and may block for seconds while scanning.
     void trigger();
+    void takePhoto();
+    void updateCommands();
     void update();
-    void setConnectedStateChangeCallback(std::function<void(bool)> callback);
+    void setConnectedStateChangeCallback(void (*callback)(bool));
+    bool isConnected() const { return _connected; }
+
+    void        setCaptureMode(CaptureMode mode);
+    CaptureMode getCaptureMode() const { return _captureMode; }
+    void        setMovieQuietPeriod(unsigned long ms) { _movieQuietPeriod = ms; }
+    void        setMovieMaxLength(unsigned long ms) { _movieMaxLength = ms; }
+    bool        isRecording() const { return _recording; } // As the camera last reported
+    bool        isShooting() const { return _shotStep != ShotStep::Idle; } // Shutter or focus still held
 
   public:
     // BLEAdvertisedDeviceCallbacks
@@ -34,6 +57,9 @@ class SonyBluetoothRemote : public BLEAdvertisedDeviceCallbacks,
     void onConnect(BLEClient* pclient) override;
     void onDisconnect(BLEClient* pclient) override;
 
+    // Camera reports on the notify characteristic (FF02), from the BLE task
+    void onNotify(const uint8_t* data, size_t length);
+
     // BLESecurityCallbacks
     uint32_t onPassKeyRequest() override;
     void     onPassKeyNotify(uint32_t pass_key) override;
@@ -42,12 +68,23 @@ class SonyBluetoothRemote : public BLEAdvertisedDeviceCallbacks,
     bool     onConfirmPIN(uint32_t pin) override { return true; }
 
   private:
+    // A photo is a press and a release of the shutter, then a return to
+    // holding focus, with 100ms between. updateCommands() steps through them,
+    // so nothing waits in between.
+    enum class ShotStep
+    {
+        Idle,
+        ShutterPressed,
+        ShutterReleased,
+    };
+
     void onConnectionStateChange(bool newConnectionState);
 
     void pairOrConnect();
     bool connectToServer();
+    void setRecording(bool on);
 
-    std::function<void(bool)> _connectedStateChangeCallback;
+    void (*_connectedStateChangeCallback)(bool) = nullptr;
 
     std::string _targetCameraName = "ILCE-7CM2";
     bool        _connected        = false;   // True if we're in a usable state
@@ -55,7 +92,25 @@ class SonyBluetoothRemote : public BLEAdvertisedDeviceCallbacks,
     bool        _doConnect        = false;   // When pairing is complete, connection is needed
     BLEClient*  _pClient          = nullptr; // This is us. We're the client.
 
-    std::unique_ptr<BLEAddress> _pCameraAddress; // The Bluetooth address of the camera
+    esp_bd_addr_t _cameraAddress      = {}; // The Bluetooth address of the camera
+    bool          _cameraAddressKnown = false;
+
+    CaptureMode   _captureMode      = CaptureMode::Still;
+    unsigned long _movieQuietPeriod = 30000;  // Stop recording after this long without a trigger
+    unsigned long _movieMaxLength   = 600000; // Never let a clip grow past this
+    unsigned long _recordingStarted = 0;
+    unsigned long _lastMovieTrigger = 0;
+
+    // The record button toggles, so it's only pressed when the camera's own
+    // report says it isn't already in the state wanted, and not again until
+    // the camera has reported the last press.
+    volatile bool _recording       = false; // Reported by the camera
+    volatile bool _recordReported  = false; // Since the last press
+    bool          _recordPending   = false; // Waiting for the camera to report a press
+    unsigned long _recordPressedAt = 0;
+    bool          _clipIsOurs      = false; // Started by a trigger, so ours to stop
+    ShotStep      _shotStep         = ShotStep::Idle;
+    unsigned long _shotStepAt       = 0;
 
     BLERemoteCharacteristic* _remoteCommand = nullptr;
     BLERemoteCharacteristic* _remoteNotify  = nullptr;
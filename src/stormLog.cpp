@@ -0,0 +1,241 @@
+#include "stormLog.h"
+
+#include <Arduino.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#include "hal.h"
+
+namespace
+{
+const uint32_t      SECTOR_MAGIC   = 0x4D525453; // "STRM"
+const uint16_t      LOG_VERSION    = 2; // 2: STORM_FLAG_CONNECTED
+const size_t        SECTOR         = hal::LOG_FLASH_SECTOR;
+const size_t        MAX_SECTORS    = 32;   // 128K, about 8000 events
+const unsigned long ERASE_MS       = 50;   // A 4K sector, typically 45ms
+const unsigned long WRITE_MS       = 2;    // Up to a 256 byte page
+const unsigned long FLUSH_DELAY_MS = 5000; // Longest an event waits for a batch to fill
+
+// Starts every sector, in place of its first event
+struct SectorHeader
+{
+    uint32_t magic;
+    uint32_t sequence;  // Counts up as sectors are started
+    uint32_t nextEvent; // Sequence of the first event in the sector
+    uint16_t session;   // Running when the sector was started
+    uint16_t version;
+};
+static_assert(sizeof(SectorHeader) == sizeof(StormEvent), "Sector header takes an event's place");
+
+// CRC-16/CCITT-FALSE
+uint16_t crc16(const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint16_t       crc   = 0xFFFF;
+    for (size_t i = 0; i < size; i++)
+    {
+        crc ^= uint16_t(bytes[i] << 8);
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc & 0x8000) ? uint16_t((crc << 1) ^ 0x1021) : uint16_t(crc << 1);
+    }
+    return crc;
+}
+
+bool isValid(const StormEvent& event)
+{
+    return event.check == crc16(&event, offsetof(StormEvent, check));
+}
+
+bool isErased(const StormEvent& event)
+{
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&event);
+    return std::all_of(bytes, bytes + sizeof(event), [](uint8_t b) { return b == 0xFF; });
+}
+
+bool readHeader(size_t sector, SectorHeader& header)
+{
+    hal::readLogFlash(sector * SECTOR, &header, sizeof(header));
+    return header.magic == SECTOR_MAGIC && header.version == LOG_VERSION;
+}
+} // namespace
+
+void StormLog::begin()
+{
+    _sectors = std::min(hal::logFlashSize() / SECTOR, MAX_SECTORS);
+    if (_sectors < 2)
+    {
+        _sectors = 0; // Nowhere to log to, just keep the summary
+        return;
+    }
+
+    // The sector being filled has the highest sequence
+    SectorHeader newest = {};
+    bool         found  = false;
+    for (size_t sector = 0; sector < _sectors; sector++)
+    {
+        SectorHeader header;
+        if (readHeader(sector, header) &&
+            (!found || int32_t(header.sequence - newest.sequence) > 0))
+        {
+            newest  = header;
+            _sector = sector;
+            found   = true;
+        }
+    }
+    if (!found)
+    {
+        // Blank flash. Pretend the last sector is full, so logging starts at the first.
+        _sector         = _sectors - 1;
+        _sectorSequence = uint32_t(-1);
+        _offset         = _sectors * SECTOR;
+        return;
+    }
+
+    _sectorSequence = newest.sequence;
+    _nextSequence   = newest.nextEvent;
+    _session        = newest.session + 1;
+
+    // The events carry on until the first erased slot, if any
+    size_t start = _sector * SECTOR;
+    _offset      = start + SECTOR;
+    StormEvent page[PAGE_EVENTS];
+    for (size_t offset = start + sizeof(SectorHeader); offset < start + SECTOR;
+         offset += sizeof(page))
+    {
+        size_t count = std::min(sizeof(page), start + SECTOR - offset) / sizeof(StormEvent);
+        hal::readLogFlash(offset, page, count * sizeof(StormEvent));
+        for (size_t i = 0; i < count; i++)
+        {
+            if (isErased(page[i]))
+            {
+                _offset = offset + i * sizeof(StormEvent);
+                return;
+            }
+            if (isValid(page[i]))
+            {
+                _nextSequence = page[i].sequence + 1;
+                _session      = std::max<uint16_t>(_session, page[i].session + 1);
+            }
+        }
+    }
+}
+
+void StormLog::record(StormEventType type, int ambient, int sensitivity, uint8_t flags)
+{
+    StormEvent event;
+    event.time        = millis();
+    event.type        = uint8_t(type);
+    event.ambient     = uint8_t(constrain(ambient, 0, 255));
+    event.sensitivity = uint8_t(constrain(sensitivity, 0, 255));
+    event.flags       = flags;
+    if (!_queue.push(event))
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+void StormLog::flush(unsigned long budgetMs)
+{
+    StormEvent event;
+    while (_pendingCount < PAGE_EVENTS && _queue.pop(event))
+    {
+        finish(event);
+        _pending[_pendingCount++] = event;
+    }
+    if (_sectors == 0)
+    {
+        _pendingCount = 0;
+        return;
+    }
+
+    // Wait for a batch, so the flash sees one write for several events
+    bool batchReady = _pendingCount >= PAGE_EVENTS / 2 ||
+                      (_pendingCount > 0 && millis() - _pending[0].time >= FLUSH_DELAY_MS);
+    while (batchReady && _pendingCount > 0)
+    {
+        size_t sectorEnd = (_sector + 1) * SECTOR;
+        if (_offset == sectorEnd && !startNextSector(budgetMs))
+            return;
+        if (budgetMs < WRITE_MS)
+            return;
+
+        int count = std::min<int>(_pendingCount, (sectorEnd - _offset) / sizeof(StormEvent));
+        hal::writeLogFlash(_offset, _pending, count * sizeof(StormEvent));
+        budgetMs -= WRITE_MS;
+        _offset += count * sizeof(StormEvent);
+        _written += count;
+        _pendingCount -= count;
+        memmove(_pending, _pending + count, _pendingCount * sizeof(StormEvent));
+    }
+
+    // Once the sector is half full, erase the next one whenever there's time,
+    // so it's never left to the moment it's needed.
+    size_t next = (_sector + 1) % _sectors;
+    if (_erased != next && _offset - _sector * SECTOR >= SECTOR / 2 && budgetMs >= ERASE_MS)
+    {
+        hal::eraseLogFlashSector(next * SECTOR);
+        _erased = next;
+    }
+}
+
+void StormLog::summary(StormSummary& summary) const
+{
+    uint32_t now          = millis();
+    summary.session       = _session;
+    summary.uptime        = now;
+    summary.detected      = _detected;
+    summary.manual        = _manual;
+    summary.noCamera      = _noCamera;
+    summary.connections   = _connections;
+    summary.connectedTime = _connectedTime + (_connected ? now - _connectedSince : 0);
+    summary.written       = _written;
+    summary.dropped       = _dropped.load(std::memory_order_relaxed);
+}
+
+// Numbers an event as it comes off the queue, and counts it in the summary.
+void StormLog::finish(StormEvent& event)
+{
+    event.sequence = _nextSequence++;
+    event.session  = _session;
+    event.check    = crc16(&event, offsetof(StormEvent, check));
+
+    StormEventType type    = StormEventType(event.type);
+    bool           trigger = type == StormEventType::Detected || type == StormEventType::Manual;
+    if (trigger && !(event.flags & STORM_FLAG_CONNECTED))
+        _noCamera++;
+    else if (type == StormEventType::Detected)
+        _detected++;
+    else if (type == StormEventType::Manual)
+        _manual++;
+    else if (type == StormEventType::Connected && !_connected)
+    {
+        _connections++;
+        _connected      = true;
+        _connectedSince = event.time;
+    }
+    else if (type == StormEventType::Disconnected && _connected)
+    {
+        _connectedTime += event.time - _connectedSince;
+        _connected = false;
+    }
+}
+
+bool StormLog::startNextSector(unsigned long& budgetMs)
+{
+    size_t        next = (_sector + 1) % _sectors;
+    unsigned long cost = (_erased == next ? 0 : ERASE_MS) + WRITE_MS;
+    if (budgetMs < cost)
+        return false;
+
+    if (_erased != next)
+        hal::eraseLogFlashSector(next * SECTOR);
+    SectorHeader header = {SECTOR_MAGIC, _sectorSequence + 1, _pending[0].sequence, _session,
+                           LOG_VERSION};
+    hal::writeLogFlash(next * SECTOR, &header, sizeof(header));
+    budgetMs -= cost;
+
+    _sector = next;
+    _sectorSequence++;
+    _offset = next * SECTOR + sizeof(header);
+    _erased = NO_SECTOR;
+    return true;
+}
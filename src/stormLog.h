@@ -0,0 +1,111 @@
+#pragma once
+// Storm session log.
+//
+// Every trigger, and every time the camera connects or disconnects, is kept as
+// a 16 byte StormEvent in a circular log in flash, so a night's activity can be
+// gone through afterwards with tools/decodeStormLog.py.
+//
+// The log is a ring of flash sectors, each starting with a header that numbers
+// it. Events are appended in order and the next sector is erased just ahead of
+// use, so all the sectors wear equally. On boot, the highest numbered sector
+// is the one that was being filled.
+//
+// record() can be called from any task and never blocks: events wait in RAM
+// until flush() writes them out in batches, from a background task. Flash
+// erases and writes stall both cores, sensing included, so flush() is told how
+// long it may stall for, and leaves the rest for a later call.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "mpscRing.h"
+
+enum class StormEventType : uint8_t
+{
+    Boot,
+    Detected, // Triggered by the light sensors
+    Manual,   // Triggered by the Fire button
+    Connected,
+    Disconnected,
+};
+
+const uint8_t STORM_FLAG_MOVIE      = 0x01; // In movie mode
+const uint8_t STORM_FLAG_PHOTODIODE = 0x02; // The photodiode saw the flash
+const uint8_t STORM_FLAG_RUNNING    = 0x04; // Trigger enabled
+const uint8_t STORM_FLAG_CONNECTED  = 0x08; // Camera connected; a trigger without it took nothing
+
+// As stored in flash, little endian
+struct StormEvent
+{
+    uint32_t sequence;    // Counts up across sessions; 0xFFFFFFFF is erased flash
+    uint32_t time;        // Milliseconds since this session's boot
+    uint16_t session;     // Counts boots
+    uint8_t  type;        // StormEventType
+    uint8_t  ambient;     // LDR reading, 0..100
+    uint8_t  sensitivity; // Trigger level in effect
+    uint8_t  flags;       // STORM_FLAG_*
+    uint16_t check;       // CRC-16 of the bytes before it, catches a write cut short
+};
+static_assert(sizeof(StormEvent) == 16, "StormEvent is a fixed flash record");
+
+// This session so far
+struct StormSummary
+{
+    uint16_t session;
+    uint32_t uptime;        // ms
+    uint32_t detected;      // Triggers that reached the camera
+    uint32_t manual;
+    uint32_t noCamera;      // Triggers, either kind, with no camera connected
+    uint32_t connections;
+    uint32_t connectedTime; // ms in total, up to now
+    uint32_t written;       // Events in flash
+    uint32_t dropped;       // Events lost to a full queue
+};
+
+class StormLog
+{
+  public:
+    // Finds where the log left off. Events recorded before this are kept.
+    void begin();
+
+    void record(StormEventType type, int ambient, int sensitivity, uint8_t flags);
+
+    // Writes out waiting events, stalling the flash for no more than budgetMs.
+    // Only ever call from one task.
+    void flush(unsigned long budgetMs);
+
+    void summary(StormSummary& summary) const;
+
+  private:
+    static const int    PAGE_EVENTS = 16;
+    static const size_t NO_SECTOR   = size_t(-1);
+
+    void finish(StormEvent& event);
+    bool startNextSector(unsigned long& budgetMs);
+
+    MpscRing<StormEvent, 32> _queue;
+    std::atomic<uint32_t>    _dropped{0};
+
+    // Flash position, only touched by begin() and flush()
+    size_t   _sectors        = 0; // In the log, 0 if there's no flash for it
+    size_t   _sector         = 0; // Being filled
+    uint32_t _sectorSequence = 0;
+    size_t   _offset         = 0; // Of the next event in flash
+    size_t   _erased         = NO_SECTOR; // Next sector, when erased ahead of time
+    uint32_t _nextSequence   = 0;
+    uint16_t _session        = 0;
+
+    StormEvent _pending[PAGE_EVENTS]; // Taken off the queue, waiting to be written
+    int        _pendingCount = 0;
+
+    // Summary, kept by flush() as events come off the queue
+    uint32_t _detected       = 0;
+    uint32_t _manual         = 0;
+    uint32_t _noCamera       = 0;
+    uint32_t _connections    = 0;
+    uint32_t _connectedTime  = 0;
+    uint32_t _connectedSince = 0;
+    bool     _connected      = false;
+    uint32_t _written        = 0;
+};
@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+"""Decodes the storm log (src/stormLog.h) from a dump of its flash.
+
+Dump the spiffs partition of the board, e.g. with the standard 4MB partition
+table:
+
+    esptool.py read_flash 0x290000 0x20000 storm.bin
+    tools/decodeStormLog.py storm.bin
+
+The simulator's --flash file can be decoded the same way. Lists every event,
+oldest first, then sums up each session.
+"""
+
+import argparse
+import struct
+import sys
+
+SECTOR = 4096
+SECTOR_MAGIC = 0x4D525453  # "STRM"
+LOG_VERSIONS = (1, 2)  # 2 added FLAG_CONNECTED
+EVENT = struct.Struct("<IIHBBBBH")
+HEADER = struct.Struct("<IIIHH")
+
+TYPES = ["Boot", "Detected", "Manual", "Connected", "Disconnected"]
+FLAG_MOVIE = 0x01
+FLAG_PHOTODIODE = 0x02
+FLAG_RUNNING = 0x04
+FLAG_CONNECTED = 0x08
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE, as in stormLog.cpp."""
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def read_events(image):
+    events = []
+    for start in range(0, len(image) - SECTOR + 1, SECTOR):
+        magic, _, _, _, version = HEADER.unpack_from(image, start)
+        if magic != SECTOR_MAGIC or version not in LOG_VERSIONS:
+            continue
+        for offset in range(start + EVENT.size, start + SECTOR, EVENT.size):
+            raw = image[offset:offset + EVENT.size]
+            sequence, time, session, kind, ambient, sensitivity, flags, check = EVENT.unpack(raw)
+            if check != crc16(raw[:-2]):
+                continue  # Erased, or a write cut short
+            if version == 1:
+                flags |= FLAG_CONNECTED  # Not recorded yet; every trigger was counted
+            events.append({
+                "sequence": sequence,
+                "time": time,
+                "session": session,
+                "type": TYPES[kind] if kind < len(TYPES) else "Type%d" % kind,
+                "ambient": ambient,
+                "sensitivity": sensitivity,
+                "flags": flags,
+            })
+    events.sort(key=lambda event: event["sequence"])
+    return events
+
+
+def clock(ms):
+    seconds = ms // 1000
+    return "%d:%02d:%02d.%03d" % (seconds // 3600, seconds // 60 % 60, seconds % 60, ms % 1000)
+
+
+def flag_text(flags):
+    words = []
+    if flags & FLAG_RUNNING:
+        words.append("running")
+    if flags & FLAG_MOVIE:
+        words.append("movie")
+    if flags & FLAG_PHOTODIODE:
+        words.append("photodiode")
+    if flags & FLAG_CONNECTED:
+        words.append("connected")
+    return " ".join(words)
+
+
+def summarise(session, events):
+    # A trigger with no camera connected took no photo, so it's counted apart
+    triggers = [event for event in events if event["type"] in ("Detected", "Manual")]
+    detected = sum(1 for event in triggers
+                   if event["type"] == "Detected" and event["flags"] & FLAG_CONNECTED)
+    manual = sum(1 for event in triggers
+                 if event["type"] == "Manual" and event["flags"] & FLAG_CONNECTED)
+    no_camera = len(triggers) - detected - manual
+    length = events[-1]["time"]  # Up to the last event logged
+
+    connected = 0
+    connections = 0
+    since = None
+    for event in events:
+        if event["type"] == "Connected" and since is None:
+            connections += 1
+            since = event["time"]
+        elif event["type"] == "Disconnected" and since is not None:
+            connected += event["time"] - since
+            since = None
+    if since is not None:
+        connected += length - since
+
+    minutes = max(length / 60000.0, 1.0)
+    print("Session %d: %s logged, %d triggers (%d detected, %d manual), %.2f per minute, "
+          "%d more with no camera, camera connected %s (%d%%) over %d connections"
+          % (session, clock(length), detected + manual, detected, manual,
+             (detected + manual) / minutes, no_camera, clock(connected),
+             100 * connected // max(length, 1), connections))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("image", help="flash dump of the storm log")
+    parser.add_argument("--summary", action="store_true", help="only sum up each session")
+    args = parser.parse_args()
+
+    with open(args.image, "rb") as file:
+        image = file.read()
+    events = read_events(image)
+    if not events:
+        print("No storm log events found")
+        return 1
+
+    if not args.summary:
+        print("%10s %7s %13s  %-12s %7s %11s  %s"
+              % ("Sequence", "Session", "Time", "Event", "Ambient", "Sensitivity", "Flags"))
+        for event in events:
+            print("%10d %7d %13s  %-12s %7d %11d  %s"
+                  % (event["sequence"], event["session"], clock(event["time"]), event["type"],
+                     event["ambient"], event["sensitivity"], flag_text(event["flags"])))
+        print()
+
+    sessions = {}
+    for event in events:
+        sessions.setdefault(event["session"], []).append(event)
+    for session in sorted(sessions):
+        summarise(session, sessions[session])
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())